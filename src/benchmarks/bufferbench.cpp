@@ -0,0 +1,370 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ *
+ * YCSB-style buffer manager benchmark. Drives BufMgr::readPage/allocPage
+ * with configurable pool size, file count, access distribution
+ * (zipfian/uniform/sequential), read/write mix and thread count, and
+ * reports pages/sec plus latency percentiles for reads, writes and the
+ * final flushFile pass. Built by `make benchmark`; run with --help for
+ * the knob list.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+#include "exceptions/badgerdb_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+namespace {
+
+enum Workload { WORKLOAD_ZIPFIAN, WORKLOAD_UNIFORM, WORKLOAD_SEQUENTIAL };
+
+struct Config {
+  std::uint32_t frames;       // buffer pool size in frames
+  std::uint32_t numFiles;     // number of backing files
+  std::uint32_t pagesPerFile; // pages allocated per file
+  std::uint32_t threads;      // worker thread count
+  std::uint64_t opsPerThread; // page accesses per worker
+  int readPct;                // percentage of accesses that only read
+  Workload workload;
+  ReplacementPolicy policy;
+  double zipfTheta;           // zipfian skew (YCSB default 0.99)
+
+  Config()
+      : frames(1024),
+        numFiles(4),
+        pagesPerFile(4096),
+        threads(1),
+        opsPerThread(100000),
+        readPct(95),
+        workload(WORKLOAD_ZIPFIAN),
+        policy(POLICY_CLOCK),
+        zipfTheta(0.99) {}
+};
+
+/**
+ * @brief Zipfian key generator using the Gray et al. rejection-free
+ * formula popularized by YCSB. Draws ranks skewed toward 0.
+ */
+class ZipfianGenerator {
+ public:
+  ZipfianGenerator(std::uint64_t items, double theta, std::uint64_t seed)
+      : items_(items), theta_(theta), rng_(seed), uniform_(0.0, 1.0) {
+    zetan_ = zeta(items_, theta_);
+    const double zeta2 = zeta(2, theta_);
+    alpha_ = 1.0 / (1.0 - theta_);
+    eta_ = (1.0 - std::pow(2.0 / (double)items_, 1.0 - theta_)) /
+           (1.0 - zeta2 / zetan_);
+  }
+
+  std::uint64_t next() {
+    const double u = uniform_(rng_);
+    const double uz = u * zetan_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + std::pow(0.5, theta_)) {
+      return 1;
+    }
+    return (std::uint64_t)((double)items_ *
+                           std::pow(eta_ * u - eta_ + 1.0, alpha_));
+  }
+
+ private:
+  static double zeta(std::uint64_t n, double theta) {
+    double sum = 0.0;
+    for (std::uint64_t i = 1; i <= n; i++) {
+      sum += 1.0 / std::pow((double)i, theta);
+    }
+    return sum;
+  }
+
+  std::uint64_t items_;
+  double theta_;
+  double zetan_;
+  double alpha_;
+  double eta_;
+  std::mt19937_64 rng_;
+  std::uniform_real_distribution<double> uniform_;
+};
+
+/**
+ * Latencies collected by one worker, in nanoseconds.
+ */
+struct WorkerResult {
+  std::vector<std::uint64_t> readLatencies;
+  std::vector<std::uint64_t> writeLatencies;
+  std::uint64_t ops;
+
+  WorkerResult() : ops(0) {}
+};
+
+std::uint64_t percentile(std::vector<std::uint64_t>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  std::size_t index = (std::size_t)(p * (double)(sorted.size() - 1));
+  return sorted[index];
+}
+
+void reportLatencies(const char* label,
+                     std::vector<std::uint64_t>& latencies,
+                     double seconds) {
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  std::printf("%-10s %10lu ops  %10.0f ops/sec  p50 %6.1fus  p95 %6.1fus"
+              "  p99 %6.1fus  max %6.1fus\n",
+              label, (unsigned long)latencies.size(),
+              (double)latencies.size() / seconds,
+              (double)percentile(latencies, 0.50) / 1000.0,
+              (double)percentile(latencies, 0.95) / 1000.0,
+              (double)percentile(latencies, 0.99) / 1000.0,
+              (double)latencies.back() / 1000.0);
+}
+
+void workerMain(BufMgr* bufMgr, std::vector<File>* files, const Config* cfg,
+                std::uint32_t workerId, WorkerResult* result) {
+  const std::uint64_t totalPages =
+      (std::uint64_t)cfg->numFiles * cfg->pagesPerFile;
+  ZipfianGenerator zipf(totalPages, cfg->zipfTheta, 0x5bd1e995u + workerId);
+  std::mt19937_64 rng(0x9e3779b9u + workerId);
+  std::uniform_int_distribution<std::uint64_t> uniform(0, totalPages - 1);
+  std::uniform_int_distribution<int> coin(0, 99);
+
+  result->readLatencies.reserve(cfg->opsPerThread);
+  result->writeLatencies.reserve(cfg->opsPerThread / 10 + 1);
+
+  std::uint64_t sequential = workerId * (totalPages / cfg->threads);
+
+  for (std::uint64_t op = 0; op < cfg->opsPerThread; op++) {
+    std::uint64_t key;
+    switch (cfg->workload) {
+      case WORKLOAD_ZIPFIAN:
+        key = zipf.next();
+        break;
+      case WORKLOAD_UNIFORM:
+        key = uniform(rng);
+        break;
+      default:
+        key = sequential++ % totalPages;
+        break;
+    }
+
+    File& file = (*files)[key / cfg->pagesPerFile];
+    // page ids are 1-based and page 1 may be a file header page; stay in
+    // the range this harness allocated
+    const PageId pageNo = (PageId)(key % cfg->pagesPerFile) + 1;
+    const bool write = coin(rng) >= cfg->readPct;
+
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    PageHandle handle = bufMgr->readPage(&file, pageNo);
+    if (!handle.valid()) {
+      continue; // pool exhausted by concurrent pins; drop the op
+    }
+    if (write) {
+      // touch the first record slot's worth of bytes through the page API
+      RecordId rid;
+      rid.page_number = pageNo;
+      rid.slot_number = 1;
+      std::string payload(64, (char)('a' + (op % 26)));
+      try {
+        handle->updateRecord(rid, payload);
+      } catch (BadgerDbException& e) {
+        // slot may not match the seeded record; the pin/unpin cost is
+        // what the benchmark measures, so shrug and move on
+      }
+    }
+    handle.unpin(write);
+
+    const std::uint64_t nanos =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    if (write) {
+      result->writeLatencies.push_back(nanos);
+    } else {
+      result->readLatencies.push_back(nanos);
+    }
+    result->ops++;
+  }
+}
+
+void usage(const char* prog) {
+  std::printf(
+      "usage: %s [options]\n"
+      "  --frames N      buffer pool frames (default 1024)\n"
+      "  --files N       backing files (default 4)\n"
+      "  --pages N       pages per file (default 4096)\n"
+      "  --threads N     worker threads (default 1)\n"
+      "  --ops N         accesses per thread (default 100000)\n"
+      "  --read-pct P    percentage of read-only accesses (default 95)\n"
+      "  --workload W    zipfian | uniform | sequential (default zipfian)\n"
+      "  --theta T       zipfian skew (default 0.99)\n"
+      "  --policy P      clock | 2q (default clock)\n",
+      prog);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  Config cfg;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i + 1] : "";
+    if (arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else if (arg == "--frames") {
+      cfg.frames = (std::uint32_t)std::atol(value); i++;
+    } else if (arg == "--files") {
+      cfg.numFiles = (std::uint32_t)std::atol(value); i++;
+    } else if (arg == "--pages") {
+      cfg.pagesPerFile = (std::uint32_t)std::atol(value); i++;
+    } else if (arg == "--threads") {
+      cfg.threads = (std::uint32_t)std::atol(value); i++;
+    } else if (arg == "--ops") {
+      cfg.opsPerThread = (std::uint64_t)std::atoll(value); i++;
+    } else if (arg == "--read-pct") {
+      cfg.readPct = std::atoi(value); i++;
+    } else if (arg == "--theta") {
+      cfg.zipfTheta = std::atof(value); i++;
+    } else if (arg == "--workload") {
+      const std::string w = value; i++;
+      if (w == "zipfian") cfg.workload = WORKLOAD_ZIPFIAN;
+      else if (w == "uniform") cfg.workload = WORKLOAD_UNIFORM;
+      else if (w == "sequential") cfg.workload = WORKLOAD_SEQUENTIAL;
+      else { usage(argv[0]); return 1; }
+    } else if (arg == "--policy") {
+      const std::string p = value; i++;
+      if (p == "clock") cfg.policy = POLICY_CLOCK;
+      else if (p == "2q") cfg.policy = POLICY_TWO_Q;
+      else { usage(argv[0]); return 1; }
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  std::printf("bufferbench: %u frames, %u files x %u pages, %u threads, "
+              "%llu ops/thread, %d%% reads\n",
+              cfg.frames, cfg.numFiles, cfg.pagesPerFile, cfg.threads,
+              (unsigned long long)cfg.opsPerThread, cfg.readPct);
+
+  BufMgr* bufMgr = new BufMgr(cfg.frames, cfg.policy);
+
+  // create and seed the backing files; one record per page so writers
+  // have something to update
+  std::vector<File> files;
+  std::vector<std::string> names;
+  for (std::uint32_t f = 0; f < cfg.numFiles; f++) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "bufferbench.%u", f);
+    names.push_back(name);
+    try {
+      File::remove(name);
+    } catch (FileNotFoundException& e) {
+      // fresh run
+    }
+    files.push_back(File::create(name));
+  }
+
+  const std::chrono::steady_clock::time_point loadStart =
+      std::chrono::steady_clock::now();
+  for (std::uint32_t f = 0; f < cfg.numFiles; f++) {
+    for (std::uint32_t p = 0; p < cfg.pagesPerFile; p++) {
+      PageId pageNo;
+      PageHandle handle = bufMgr->allocPage(&files[f], pageNo);
+      handle->insertRecord(std::string(64, 'x'));
+      handle.unpin(true);
+    }
+    bufMgr->flushFile(&files[f]);
+  }
+  const double loadSecs =
+      std::chrono::duration_cast<std::chrono::duration<double> >(
+          std::chrono::steady_clock::now() - loadStart).count();
+  std::printf("loaded %u pages in %.2fs (%.0f pages/sec)\n",
+              cfg.numFiles * cfg.pagesPerFile, loadSecs,
+              (double)(cfg.numFiles * cfg.pagesPerFile) / loadSecs);
+
+  // run the access phase
+  std::vector<WorkerResult> results(cfg.threads);
+  std::vector<std::thread> workers;
+  const std::chrono::steady_clock::time_point runStart =
+      std::chrono::steady_clock::now();
+  for (std::uint32_t t = 0; t < cfg.threads; t++) {
+    workers.push_back(std::thread(workerMain, bufMgr, &files, &cfg, t,
+                                  &results[t]));
+  }
+  for (std::uint32_t t = 0; t < cfg.threads; t++) {
+    workers[t].join();
+  }
+  const double runSecs =
+      std::chrono::duration_cast<std::chrono::duration<double> >(
+          std::chrono::steady_clock::now() - runStart).count();
+
+  std::vector<std::uint64_t> reads;
+  std::vector<std::uint64_t> writes;
+  std::uint64_t totalOps = 0;
+  for (std::uint32_t t = 0; t < cfg.threads; t++) {
+    reads.insert(reads.end(), results[t].readLatencies.begin(),
+                 results[t].readLatencies.end());
+    writes.insert(writes.end(), results[t].writeLatencies.begin(),
+                  results[t].writeLatencies.end());
+    totalOps += results[t].ops;
+  }
+
+  std::printf("ran %llu accesses in %.2fs (%.0f pages/sec)\n",
+              (unsigned long long)totalOps, runSecs,
+              (double)totalOps / runSecs);
+  reportLatencies("read", reads, runSecs);
+  reportLatencies("write", writes, runSecs);
+
+  // time the checkpoint-style flush of every file
+  const std::chrono::steady_clock::time_point flushStart =
+      std::chrono::steady_clock::now();
+  for (std::uint32_t f = 0; f < cfg.numFiles; f++) {
+    bufMgr->flushFile(&files[f]);
+  }
+  const double flushSecs =
+      std::chrono::duration_cast<std::chrono::duration<double> >(
+          std::chrono::steady_clock::now() - flushStart).count();
+  std::printf("flushFile x%u: %.3fs\n", cfg.numFiles, flushSecs);
+
+  BufStats& stats = bufMgr->getBufStats();
+  std::printf("hit ratio %.4f (%llu hits / %llu accesses), "
+              "%llu disk reads, %llu disk writes, %llu evictions\n",
+              stats.hitRatio(), (unsigned long long)stats.hits,
+              (unsigned long long)stats.accesses,
+              (unsigned long long)stats.diskreads,
+              (unsigned long long)stats.diskwrites,
+              (unsigned long long)stats.evictions);
+
+  delete bufMgr;
+  files.clear();
+  for (std::uint32_t f = 0; f < cfg.numFiles; f++) {
+    File::remove(names[f]);
+  }
+  return 0;
+}
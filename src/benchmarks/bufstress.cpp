@@ -0,0 +1,417 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ *
+ * Multithreaded stress harness for the buffer manager's concurrent path.
+ * N workers hammer one BufMgr with a mix of pin/verify/unpin on shared
+ * files and read/update/alloc/dispose on private files, checking page
+ * contents on every access (a page served from the wrong frame or a
+ * double-mapped hash entry shows up as a payload mismatch). After each
+ * round the pool is quiesced and every file is flushed — a leaked pin
+ * surfaces as PagePinnedException — and all surviving pages re-verified.
+ * Reports throughput scaling from 1 thread up to --threads. Built by
+ * `make stress`; run with --help for the knob list.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+#include "exceptions/badgerdb_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/page_pinned_exception.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+namespace {
+
+struct Config {
+  std::uint32_t frames;        // buffer pool size in frames
+  std::uint32_t sharedFiles;   // files all workers read
+  std::uint32_t sharedPages;   // pages per shared file
+  std::uint32_t privatePages;  // pages seeded per worker-private file
+  std::uint32_t threads;       // maximum worker thread count
+  std::uint64_t opsPerThread;  // operations per worker per round
+  ReplacementPolicy policy;
+
+  Config()
+      : frames(256),
+        sharedFiles(4),
+        sharedPages(512),
+        privatePages(128),
+        threads((std::uint32_t)std::thread::hardware_concurrency()),
+        opsPerThread(50000),
+        policy(POLICY_CLOCK) {
+    if (threads == 0) {
+      threads = 4;
+    }
+  }
+};
+
+std::atomic<std::uint64_t> checksFailed(0);
+
+/**
+ * Invariant check: on failure prints the message and aborts the run, so
+ * a thread-safety bug never scrolls by unnoticed.
+ */
+void check(bool condition, const char* what) {
+  if (!condition) {
+    checksFailed++;
+    std::fprintf(stderr, "INVARIANT VIOLATED: %s\n", what);
+    std::abort();
+  }
+}
+
+/**
+ * Canonical payload for a page; every access verifies the page it was
+ * handed actually holds this. A stale or cross-wired frame fails here.
+ */
+std::string payloadFor(const std::string& tag, const PageId pageNo) {
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "%s:%u", tag.c_str(), (unsigned)pageNo);
+  return std::string(buf);
+}
+
+/**
+ * State of one worker's private file: which pages are live and the tag
+ * their payloads carry. Only the owning worker touches it.
+ */
+struct PrivateFileState {
+  File* file;
+  std::string tag;
+  std::vector<PageId> livePages;
+};
+
+void verifyPage(const Page* page, const std::string& tag,
+                const PageId pageNo) {
+  RecordId rid;
+  rid.page_number = pageNo;
+  rid.slot_number = 1;
+  check(page->getRecord(rid) == payloadFor(tag, pageNo),
+        "page payload does not match its identity");
+}
+
+void workerMain(BufMgr* bufMgr, std::vector<File>* sharedFiles,
+                const Config* cfg, PrivateFileState* priv,
+                std::uint32_t workerId, std::uint64_t* opsDone) {
+  std::mt19937_64 rng(0x7f4a7c15u + workerId);
+  std::uniform_int_distribution<int> mix(0, 99);
+  std::uniform_int_distribution<std::uint32_t> sharedFile(
+      0, cfg->sharedFiles - 1);
+  std::uniform_int_distribution<PageId> sharedPage(1, cfg->sharedPages);
+
+  std::uint64_t done = 0;
+  for (std::uint64_t op = 0; op < cfg->opsPerThread; op++) {
+    const int dice = mix(rng);
+
+    if (dice < 60) {
+      // pin/verify/unpin a shared page
+      const std::uint32_t f = sharedFile(rng);
+      const PageId pageNo = sharedPage(rng);
+      PageHandle handle = bufMgr->readPage(&(*sharedFiles)[f], pageNo);
+      if (!handle.valid()) {
+        continue; // pool exhausted by concurrent pins; drop the op
+      }
+      char tag[16];
+      std::snprintf(tag, sizeof(tag), "s%u", f);
+      verifyPage(handle.page(), tag, pageNo);
+    } else if (dice < 75) {
+      // batch-pin a small run of shared pages
+      const std::uint32_t f = sharedFile(rng);
+      PageId pageNos[4];
+      Page* pages[4];
+      const PageId first = sharedPage(rng);
+      for (int i = 0; i < 4; i++) {
+        pageNos[i] = (first + i - 1) % cfg->sharedPages + 1;
+      }
+      try {
+        bufMgr->readPages(&(*sharedFiles)[f], pageNos, 4, pages);
+      } catch (BufferExceededException& e) {
+        continue;
+      }
+      char tag[16];
+      std::snprintf(tag, sizeof(tag), "s%u", f);
+      for (int i = 0; i < 4; i++) {
+        verifyPage(pages[i], tag, pageNos[i]);
+      }
+      bufMgr->unPinPages(&(*sharedFiles)[f], pageNos, 4, false);
+    } else if (dice < 90) {
+      // re-dirty a private page in place
+      if (priv->livePages.empty()) {
+        continue;
+      }
+      std::uniform_int_distribution<std::size_t> pick(
+          0, priv->livePages.size() - 1);
+      const PageId pageNo = priv->livePages[pick(rng)];
+      PageHandle handle = bufMgr->readPage(priv->file, pageNo);
+      if (!handle.valid()) {
+        continue;
+      }
+      verifyPage(handle.page(), priv->tag, pageNo);
+      RecordId rid;
+      rid.page_number = pageNo;
+      rid.slot_number = 1;
+      handle->updateRecord(rid, payloadFor(priv->tag, pageNo));
+      handle.unpin(true);
+    } else if (dice < 95) {
+      // grow the private file
+      PageId pageNo;
+      try {
+        PageHandle handle = bufMgr->allocPage(priv->file, pageNo);
+        handle->insertRecord(payloadFor(priv->tag, pageNo));
+        handle.unpin(true);
+        priv->livePages.push_back(pageNo);
+      } catch (BufferExceededException& e) {
+        continue;
+      }
+    } else {
+      // dispose a private page (keep a floor so updates have targets)
+      if (priv->livePages.size() <= 8) {
+        continue;
+      }
+      std::uniform_int_distribution<std::size_t> pick(
+          0, priv->livePages.size() - 1);
+      const std::size_t slot = pick(rng);
+      const PageId pageNo = priv->livePages[slot];
+      bufMgr->disposePage(priv->file, pageNo);
+      priv->livePages[slot] = priv->livePages.back();
+      priv->livePages.pop_back();
+    }
+    done++;
+  }
+  *opsDone = done;
+}
+
+/**
+ * Quiesced whole-pool validation: flushes every file (a pin leaked by
+ * the round turns into PagePinnedException here) and re-reads every
+ * surviving page to check its payload.
+ */
+void validateAll(BufMgr* bufMgr, std::vector<File>& sharedFiles,
+                 std::vector<PrivateFileState>& privs, const Config& cfg) {
+  for (std::uint32_t f = 0; f < sharedFiles.size(); f++) {
+    try {
+      bufMgr->flushFile(&sharedFiles[f]);
+    } catch (PagePinnedException& e) {
+      check(false, "pin leaked on a shared file (flushFile threw)");
+    }
+    for (PageId p = 1; p <= cfg.sharedPages; p++) {
+      PageHandle handle = bufMgr->readPage(&sharedFiles[f], p);
+      check(handle.valid(), "shared page unreadable after flush");
+      char tag[16];
+      std::snprintf(tag, sizeof(tag), "s%u", f);
+      verifyPage(handle.page(), tag, p);
+    }
+  }
+  for (std::size_t w = 0; w < privs.size(); w++) {
+    try {
+      bufMgr->flushFile(privs[w].file);
+    } catch (PagePinnedException& e) {
+      check(false, "pin leaked on a private file (flushFile threw)");
+    }
+    for (std::size_t i = 0; i < privs[w].livePages.size(); i++) {
+      PageHandle handle = bufMgr->readPage(privs[w].file,
+                                           privs[w].livePages[i]);
+      check(handle.valid(), "private page unreadable after flush");
+      verifyPage(handle.page(), privs[w].tag, privs[w].livePages[i]);
+    }
+  }
+}
+
+void usage(const char* prog) {
+  std::printf(
+      "usage: %s [options]\n"
+      "  --frames N      buffer pool frames (default 256)\n"
+      "  --files N       shared files (default 4)\n"
+      "  --pages N       pages per shared file (default 512)\n"
+      "  --private N     pages seeded per worker file (default 128)\n"
+      "  --threads N     maximum worker threads (default: cores)\n"
+      "  --ops N         operations per thread per round (default 50000)\n"
+      "  --policy P      clock | 2q (default clock)\n",
+      prog);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  Config cfg;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i + 1] : "";
+    if (arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else if (arg == "--frames") {
+      cfg.frames = (std::uint32_t)std::atol(value); i++;
+    } else if (arg == "--files") {
+      cfg.sharedFiles = (std::uint32_t)std::atol(value); i++;
+    } else if (arg == "--pages") {
+      cfg.sharedPages = (std::uint32_t)std::atol(value); i++;
+    } else if (arg == "--private") {
+      cfg.privatePages = (std::uint32_t)std::atol(value); i++;
+    } else if (arg == "--threads") {
+      cfg.threads = (std::uint32_t)std::atol(value); i++;
+    } else if (arg == "--ops") {
+      cfg.opsPerThread = (std::uint64_t)std::atoll(value); i++;
+    } else if (arg == "--policy") {
+      const std::string p = value; i++;
+      if (p == "clock") cfg.policy = POLICY_CLOCK;
+      else if (p == "2q") cfg.policy = POLICY_TWO_Q;
+      else { usage(argv[0]); return 1; }
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  std::printf("bufstress: %u frames, %u shared files x %u pages, "
+              "up to %u threads, %llu ops/thread\n",
+              cfg.frames, cfg.sharedFiles, cfg.sharedPages, cfg.threads,
+              (unsigned long long)cfg.opsPerThread);
+
+  BufMgr* bufMgr = new BufMgr(cfg.frames, cfg.policy);
+
+  // seed the shared files
+  std::vector<File> sharedFiles;
+  std::vector<std::string> names;
+  for (std::uint32_t f = 0; f < cfg.sharedFiles; f++) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "bufstress.s%u", f);
+    names.push_back(name);
+    try {
+      File::remove(name);
+    } catch (FileNotFoundException& e) {
+      // fresh run
+    }
+    sharedFiles.push_back(File::create(name));
+    char tag[16];
+    std::snprintf(tag, sizeof(tag), "s%u", f);
+    for (std::uint32_t p = 0; p < cfg.sharedPages; p++) {
+      PageId pageNo;
+      PageHandle handle = bufMgr->allocPage(&sharedFiles[f], pageNo);
+      handle->insertRecord(payloadFor(tag, pageNo));
+      handle.unpin(true);
+    }
+    bufMgr->flushFile(&sharedFiles[f]);
+  }
+
+  // seed one private file per worker
+  std::vector<File> privateFiles;
+  std::vector<PrivateFileState> privs(cfg.threads);
+  for (std::uint32_t w = 0; w < cfg.threads; w++) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "bufstress.p%u", w);
+    names.push_back(name);
+    try {
+      File::remove(name);
+    } catch (FileNotFoundException& e) {
+      // fresh run
+    }
+    privateFiles.push_back(File::create(name));
+  }
+  for (std::uint32_t w = 0; w < cfg.threads; w++) {
+    privs[w].file = &privateFiles[w];
+    char tag[16];
+    std::snprintf(tag, sizeof(tag), "p%u", w);
+    privs[w].tag = tag;
+    for (std::uint32_t p = 0; p < cfg.privatePages; p++) {
+      PageId pageNo;
+      PageHandle handle = bufMgr->allocPage(&privateFiles[w], pageNo);
+      handle->insertRecord(payloadFor(privs[w].tag, pageNo));
+      handle.unpin(true);
+      privs[w].livePages.push_back(pageNo);
+    }
+    bufMgr->flushFile(&privateFiles[w]);
+  }
+
+  // throughput scaling: 1, 2, 4, ... up to --threads, validating the
+  // whole pool after every round
+  double baseline = 0.0;
+  std::uint32_t round = 0;
+  for (std::uint32_t t = 1; t <= cfg.threads;
+       t = (t * 2 <= cfg.threads || t == cfg.threads) ? t * 2 : cfg.threads) {
+    // alternate rounds with the compressed victim cache on, so both the
+    // cached and uncached eviction paths run under full contention
+    const bool victimOn = (round++ % 2) == 1;
+    bufMgr->setVictimCacheBytes(victimOn ? 8 * 1024 * 1024 : 0);
+    std::vector<std::thread> workers;
+    std::vector<std::uint64_t> opsDone(t, 0);
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (std::uint32_t w = 0; w < t; w++) {
+      workers.push_back(std::thread(workerMain, bufMgr, &sharedFiles, &cfg,
+                                    &privs[w], w, &opsDone[w]));
+    }
+    for (std::uint32_t w = 0; w < t; w++) {
+      workers[w].join();
+    }
+    const double secs =
+        std::chrono::duration_cast<std::chrono::duration<double> >(
+            std::chrono::steady_clock::now() - start).count();
+
+    std::uint64_t total = 0;
+    for (std::uint32_t w = 0; w < t; w++) {
+      total += opsDone[w];
+    }
+    const double rate = (double)total / secs;
+    if (t == 1) {
+      baseline = rate;
+    }
+    std::printf("%3u threads: %10llu ops in %6.2fs  %10.0f ops/sec"
+                "  scaling x%.2f%s\n",
+                t, (unsigned long long)total, secs, rate,
+                baseline > 0.0 ? rate / baseline : 0.0,
+                victimOn ? "  [victim cache]" : "");
+
+    validateAll(bufMgr, sharedFiles, privs, cfg);
+    if (t == cfg.threads) {
+      break;
+    }
+  }
+
+  const BufStats& stats = bufMgr->getBufStats();
+  std::printf("accesses %llu  hit ratio %.3f  evictions %llu "
+              "(clean %llu dirty %llu)  pin skips %llu  alloc failures %llu\n",
+              (unsigned long long)stats.accesses, stats.hitRatio(),
+              (unsigned long long)stats.evictions,
+              (unsigned long long)stats.evictionsClean,
+              (unsigned long long)stats.evictionsDirty,
+              (unsigned long long)stats.pinSkips,
+              (unsigned long long)stats.allocFailures);
+
+  std::uint64_t victimHits, victimStores, victimEvictions;
+  bufMgr->getVictimCacheStats(victimHits, victimStores, victimEvictions);
+  std::printf("victim cache: %llu hits  %llu stores  %llu evictions\n",
+              (unsigned long long)victimHits,
+              (unsigned long long)victimStores,
+              (unsigned long long)victimEvictions);
+
+  delete bufMgr;
+  sharedFiles.clear();
+  privateFiles.clear();
+  for (std::size_t i = 0; i < names.size(); i++) {
+    File::remove(names[i]);
+  }
+
+  if (checksFailed.load() != 0) {
+    std::printf("FAILED: %llu invariant violations\n",
+                (unsigned long long)checksFailed.load());
+    return 1;
+  }
+  std::printf("all invariants held\n");
+  return 0;
+}
@@ -15,97 +15,160 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+namespace {
+
+// Smallest power of two >= n (and >= 8 so tiny shards still have headroom).
+int roundUpPowerOfTwo(int n)
+{
+  int cap = 8;
+  while (cap < n)
+    cap <<= 1;
+  return cap;
+}
+
+}
+
+std::uint64_t BufHashTbl::hash(const FileId fileId, const PageId pageNo)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  // Mix the interned file id and page number with multiplicative hashing
+  // so both the shard selection (high bits) and slot selection (low bits)
+  // are well distributed.
+  std::uint64_t h = fileId;
+  h ^= static_cast<std::uint64_t>(pageNo) * 0xc2b2ae3d27d4eb4fULL;
+  h *= 0x9e3779b97f4a7c15ULL;
+  h ^= h >> 32;
+  return h;
 }
 
 BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
 {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
-  for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+  // Spread the requested capacity across the shards, with 2x headroom so
+  // probe sequences stay short even when every frame is mapped.
+  const int perShard = roundUpPowerOfTwo((2 * htSize) / NUM_STRIPES + 1);
+  for (int i = 0; i < NUM_STRIPES; i++) {
+    shards[i].capacity = perShard;
+    shards[i].size = 0;
+    shards[i].entries = new hashEntry[perShard]();
+  }
 }
 
 BufHashTbl::~BufHashTbl()
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
-    }
+  for (int i = 0; i < NUM_STRIPES; i++)
+    delete [] shards[i].entries;
+}
+
+void BufHashTbl::growShard(shard& s)
+{
+  const int newCapacity = s.capacity * 2;
+  hashEntry* newEntries = new (std::nothrow) hashEntry[newCapacity]();
+  if (!newEntries)
+    throw HashTableException();
+
+  for (int i = 0; i < s.capacity; i++) {
+    const hashEntry& entry = s.entries[i];
+    if (entry.pageNo == Page::INVALID_NUMBER)
+      continue;
+    std::uint64_t slot = hash(entry.fileId, entry.pageNo) & (newCapacity - 1);
+    while (newEntries[slot].pageNo != Page::INVALID_NUMBER)
+      slot = (slot + 1) & (newCapacity - 1);
+    newEntries[slot] = entry;
   }
-  delete [] ht;
+
+  delete [] s.entries;
+  s.entries = newEntries;
+  s.capacity = newCapacity;
 }
 
 void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
-
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
+  const FileId fileId = file->fileId();
+  const std::uint64_t h = hash(fileId, pageNo);
+  const int stripe = (h >> 48) & (NUM_STRIPES - 1);
+  std::lock_guard<std::mutex> stripeLock(stripeLatches[stripe]);
+  shard& s = shards[stripe];
+
+  // keep load factor below ~3/4 so linear probing stays cheap
+  if (4 * (s.size + 1) > 3 * s.capacity)
+    growShard(s);
+
+  std::uint64_t slot = h & (s.capacity - 1);
+  while (s.entries[slot].pageNo != Page::INVALID_NUMBER) {
+    if (s.entries[slot].fileId == fileId && s.entries[slot].pageNo == pageNo)
+      throw HashAlreadyPresentException(file->filename(),
+                                        s.entries[slot].pageNo,
+                                        s.entries[slot].frameNo);
+    slot = (slot + 1) & (s.capacity - 1);
   }
 
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
-  	throw HashTableException();
+  s.entries[slot].fileId = fileId;
+  s.entries[slot].pageNo = pageNo;
+  s.entries[slot].frameNo = frameNo;
+  s.size++;
+}
 
-  tmpBuc->file = (File*) file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo)
+{
+  if (!tryLookup(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
 }
 
-void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+bool BufHashTbl::tryLookup(const File* file, const PageId pageNo, FrameId &frameNo)
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+  const FileId fileId = file->fileId();
+  const std::uint64_t h = hash(fileId, pageNo);
+  const int stripe = (h >> 48) & (NUM_STRIPES - 1);
+  std::lock_guard<std::mutex> stripeLock(stripeLatches[stripe]);
+  shard& s = shards[stripe];
+
+  std::uint64_t slot = h & (s.capacity - 1);
+  while (s.entries[slot].pageNo != Page::INVALID_NUMBER) {
+    if (s.entries[slot].fileId == fileId && s.entries[slot].pageNo == pageNo)
     {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
+      frameNo = s.entries[slot].frameNo; // return frameNo by reference
+      return true;
     }
-    tmpBuc = tmpBuc->next;
+    slot = (slot + 1) & (s.capacity - 1);
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  return false;
 }
 
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  hashBucket* prevBuc = NULL;
-
-  while (tmpBuc)
-	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-		{
-      if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
-      else
-				ht[index] = tmpBuc->next;
+  const FileId fileId = file->fileId();
+  const std::uint64_t h = hash(fileId, pageNo);
+  const int stripe = (h >> 48) & (NUM_STRIPES - 1);
+  std::lock_guard<std::mutex> stripeLock(stripeLatches[stripe]);
+  shard& s = shards[stripe];
 
-      delete tmpBuc;
+  std::uint64_t slot = h & (s.capacity - 1);
+  while (s.entries[slot].pageNo != Page::INVALID_NUMBER) {
+    if (s.entries[slot].fileId == fileId && s.entries[slot].pageNo == pageNo)
+    {
+      // backward-shift deletion: pull subsequent probe-chain entries into
+      // the hole so no tombstones accumulate
+      std::uint64_t hole = slot;
+      std::uint64_t next = (hole + 1) & (s.capacity - 1);
+      while (s.entries[next].pageNo != Page::INVALID_NUMBER) {
+        const std::uint64_t home =
+            hash(s.entries[next].fileId, s.entries[next].pageNo) & (s.capacity - 1);
+        // move the entry back only if its home slot does not lie
+        // (cyclically) between the hole and its current position
+        const bool movable = (next > hole)
+            ? (home <= hole || home > next)
+            : (home <= hole && home > next);
+        if (movable) {
+          s.entries[hole] = s.entries[next];
+          hole = next;
+        }
+        next = (next + 1) & (s.capacity - 1);
+      }
+      s.entries[hole].pageNo = Page::INVALID_NUMBER;
+      s.size--;
       return;
     }
-		else
-		{
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
-    }
+    slot = (slot + 1) & (s.capacity - 1);
   }
 
   throw HashNotFoundException(file->filename(), pageNo);
@@ -7,21 +7,27 @@
 
 #pragma once
 
+#include <mutex>
+
 #include "file.h"
 
 namespace badgerdb {
 
 /**
-* @brief Declarations for buffer pool hash table
+* @brief Entry in one shard of the buffer pool hash table.
+*
+* Entries live in a flat array probed linearly, so the common hit
+* path touches one or two cache lines instead of chasing bucket
+* pointers through the heap.
 */
-struct hashBucket {
+struct hashEntry {
 	/**
-	 * pointer a file object (more on this below)
+	 * interned id of the file the page belongs to
 	 */
-	File *file;
+	FileId fileId;
 
 	/**
-	 * page number within a file
+	 * page number within a file; INVALID_NUMBER when the entry is empty
 	 */
 	PageId pageNo;
 
@@ -29,43 +35,86 @@ struct hashBucket {
 	 * frame number of page in the buffer pool
 	 */
 	FrameId frameNo;
-
-	/**
-	 * Next node in the hash table
-	 */
-	hashBucket*   next;
 };
 
 
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
-* @warning This class is not threadsafe.
+* The table is partitioned into NUM_STRIPES shards, each a flat
+* open-addressed array with linear probing and its own latch, so
+* threads operating on pages that hash to different shards never
+* contend with each other. Deletion uses backward shifting instead of
+* tombstones so probe sequences stay short.
 */
 class BufHashTbl
 {
  private:
 	/**
-	 *	Size of Hash Table
+	 * Number of independently latched shards the table is partitioned into.
+	 * Power of two so the shard can be selected with a mask.
+	 */
+  static const int NUM_STRIPES = 64;
+
+	/**
+	 * @brief One open-addressed shard of the table.
 	 */
-  int HTSIZE;
+	struct shard {
+		/**
+		 * Flat entry array, length <capacity>; empty entries have
+		 * pageNo == Page::INVALID_NUMBER
+		 */
+		hashEntry* entries;
+
+		/**
+		 * Capacity of the entry array (power of two)
+		 */
+		int capacity;
+
+		/**
+		 * Number of occupied entries
+		 */
+		int size;
+	};
+
+	/**
+	 * The shards making up the table
+	 */
+  shard shards[NUM_STRIPES];
+
 	/**
-	 * Actual Hash table object
+	 * Latches guarding the shards; shard i is protected by stripeLatches[i].
 	 */
-  hashBucket**  ht;
+  std::mutex stripeLatches[NUM_STRIPES];
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * returns mixed 64-bit hash computed using the file's interned id and
+	 * pageNo; the high bits select the shard and the low bits the slot
+	 * within it. Keying on the id rather than the File object's address
+	 * means every File object aliasing one underlying file probes the
+	 * same entry.
 	 *
-	 * @param file   	File object
+	 * @param fileId 	Interned file id
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  std::uint64_t hash(const FileId fileId, const PageId pageNo);
+
+	/**
+	 * Doubles the capacity of the given shard and rehashes its entries.
+	 * Caller must hold the shard's latch.
+	 *
+	 * @param s   Shard to grow
+	 */
+	void growShard(shard& s);
 
  public:
 	/**
    * Constructor of BufHashTbl class
+	 *
+	 * @param htSize	Total number of entries to size the table for; the
+	 *             	capacity is spread across the shards with headroom so
+	 *             	probe sequences stay short at full pool occupancy.
 	 */
 	BufHashTbl(const int htSize);  // constructor
 
@@ -73,7 +122,7 @@ class BufHashTbl
    * Destructor of BufHashTbl class
 	 */
   ~BufHashTbl(); // destructor
-	
+
 	/**
    * Insert entry into hash table mapping (file, pageNo) to frameNo.
 	 *
@@ -81,7 +130,7 @@ class BufHashTbl
 	 * @param pageNo 	Page number in the file
 	 * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
-   * @throws  HashTableException (optional) if could not create a new bucket as running of memory
+   * @throws  HashTableException (optional) if could not grow a shard as running of memory
 	 */
   void insert(const File* file, const PageId pageNo, const FrameId frameNo);
 
@@ -92,18 +141,31 @@ class BufHashTbl
 	 * @param file  	File object
 	 * @param pageNo	Page number in the file
 	 * @param frameNo Frame number reference
-   * @throws HashNotFoundException if the page entry is not found in the hash table 
+   * @throws HashNotFoundException if the page entry is not found in the hash table
 	 */
   void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
 
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool without
+   * throwing on a miss. Buffer misses are a routine outcome on the page
+   * request path, so callers there use this instead of paying an
+   * exception throw/unwind per miss.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, set only on a hit
+   * @return  True if the page entry was found in the hash table.
+	 */
+  bool tryLookup(const File* file, const PageId pageNo, FrameId &frameNo);
+
 	/**
    * Delete entry (file,pageNo) from hash table.
 	 *
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
-   * @throws HashNotFoundException if the page entry is not found in the hash table 
+   * @throws HashNotFoundException if the page entry is not found in the hash table
 	 */
-  void remove(const File* file, const PageId pageNo);  
+  void remove(const File* file, const PageId pageNo);
 };
 
 }
@@ -27,295 +27,2480 @@ This file contains different methods to perform buffer manager functions describ
  *
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <unordered_set>
 #include <memory>
+#include <new>
 #include <iostream>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include "buffer.h"
+#include "ioEngine.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/file_not_found_exception.h"
+
+#ifdef BADGERDB_RDTSC
+#include <x86intrin.h>
+#endif
 
 namespace badgerdb { 
 
-//----------------------------------------
-// Constructor of the class BufMgr
-//----------------------------------------
+namespace {
+
+/**
+ * Cycle counter for victim-search timing. Compiled to a real rdtsc only
+ * under -DBADGERDB_RDTSC so the always-on counters stay cheap.
+ */
+inline std::uint64_t readCycles()
+{
+#ifdef BADGERDB_RDTSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+}
+
+
+//----------------------------------------
+// Constructor of the class BufMgr
+//----------------------------------------
+
+namespace {
+
+// On-disk^W in-segment layout of a shared-memory pool: a fixed header,
+// one directory entry per frame, then the frames themselves starting on
+// a 4KB boundary. Everything is plain data — no pointers — so any
+// process generation can map and read it.
+
+struct SharedPoolHeader
+{
+	std::uint64_t magic;
+	std::uint32_t version;
+	std::uint32_t capacity;
+	std::uint32_t pageSize;
+	std::uint32_t reserved;
+};
+
+struct SharedFrameDir
+{
+	char filename[54];       // empty-terminated; longer names aren't published
+	std::uint8_t valid;
+	std::uint8_t dirty;
+	PageId pageNo;
+};
+
+const std::uint64_t SHARED_POOL_MAGIC = 0x4264625368506f6cULL; // "BdbShPol"
+const std::uint32_t SHARED_POOL_VERSION = 1;
+
+static_assert(sizeof(SharedFrameDir) == 60, "directory entries are packed");
+
+std::size_t sharedFrameOffset(const std::uint32_t capacity)
+{
+	const std::size_t raw =
+			sizeof(SharedPoolHeader) + (std::size_t)capacity * sizeof(SharedFrameDir);
+	return (raw + 4095) / 4096 * 4096;
+}
+
+}
+
+BufMgr::BufMgr(std::uint32_t bufs, ReplacementPolicy policyIn,
+		std::uint32_t numPartitionsIn)
+	: policy(policyIn), numBufs(bufs), capacityBufs(bufs),
+		writerRunning(false), prefetchRunning(false),
+		shmBase(NULL), shmBytes(0), shmFd(-1), shmDir(NULL), shmAdopted(false) {
+	construct(bufs, numPartitionsIn);
+}
+
+BufMgr::BufMgr(std::uint32_t bufs, const std::string& shmNameIn,
+		ReplacementPolicy policyIn, std::uint32_t numPartitionsIn)
+	: policy(policyIn), numBufs(bufs), capacityBufs(bufs),
+		writerRunning(false), prefetchRunning(false), shmName(shmNameIn),
+		shmBase(NULL), shmBytes(0), shmFd(-1), shmDir(NULL), shmAdopted(false) {
+	construct(bufs, numPartitionsIn);
+}
+
+BufMgr::BufMgr(const std::vector<NamedPartition>& partitionsIn,
+		ReplacementPolicy policyIn)
+	: policy(policyIn), numBufs(0), capacityBufs(0),
+		writerRunning(false), prefetchRunning(false),
+		shmBase(NULL), shmBytes(0), shmFd(-1), shmDir(NULL), shmAdopted(false) {
+	// quota geometry first, so construct() and everything downstream of it
+	// see the named boundaries instead of the equal split
+	partitionBounds.reserve(partitionsIn.size() + 1);
+	partitionBounds.push_back(0);
+	for (std::size_t i = 0; i < partitionsIn.size(); i++)
+	{
+		const std::uint32_t quota =
+				partitionsIn[i].frames > 0 ? partitionsIn[i].frames : 1;
+		partitionBounds.push_back(partitionBounds.back() + quota);
+		partitionNames[partitionsIn[i].name] = (std::uint32_t)i;
+	}
+	numBufs = capacityBufs = partitionBounds.back();
+	construct(numBufs, (std::uint32_t)partitionsIn.size());
+}
+
+/**
+ * Resolves a placement hint to a partition index; unknown names (and
+ * pools without named partitions) fall back to the page's default
+ * placement.
+ * @param hint the partition name given by the caller
+ * @param file the file owning the page
+ * @param pageNo the page number within the file
+ * @return the partition to fault the page into
+ */
+std::uint32_t BufMgr::hintPartition(const std::string& hint, const File* file,
+		const PageId pageNo) const
+{
+	std::unordered_map<std::string, std::uint32_t>::const_iterator it =
+			partitionNames.find(hint);
+	return it != partitionNames.end() ? it->second
+			: homePartition(file, pageNo);
+}
+
+/**
+ * Shared body of both constructors.
+ * @param bufs number of frames in the buffer pool
+ * @param numPartitionsIn frame partitions; 0 means one per NUMA node
+ * @return void
+ */
+void BufMgr::construct(const std::uint32_t bufs,
+		const std::uint32_t numPartitionsIn)
+{
+	// one partition per NUMA node unless the caller chose; a partition
+	// needs at least one frame
+	numPartitions = numPartitionsIn != 0 ? numPartitionsIn : detectNumaNodes();
+	if (numPartitions < 1) {
+		numPartitions = 1;
+	}
+	if (numPartitions > bufs) {
+		numPartitions = bufs;
+	}
+
+	// both tables live in mmap'd slabs: the pool gets huge page backing to
+	// keep big pools out of the dTLB, and the 64-byte aligned descriptors
+	// stop neighbouring frames from false-sharing cache lines. Each
+	// partition's range of both slabs is bound to its NUMA node before
+	// first touch, so its frames fault into local memory.
+	descSlabBytes = (std::size_t)bufs * sizeof(BufDesc);
+	bufDescTable = static_cast<BufDesc*>(mapSlab(descSlabBytes));
+	bindSlabToNodes(bufDescTable, sizeof(BufDesc));
+
+  for (FrameId i = 0; i < bufs; i++) 
+  {
+		new (&bufDescTable[i]) BufDesc();
+  	bufDescTable[i].frameNo = i;
+  	bufDescTable[i].valid = false;
+		bufDescTable[i].queue = QUEUE_NONE;
+		bufDescTable[i].prev = NO_FRAME;
+		bufDescTable[i].next = NO_FRAME;
+  }
+
+	bufPoolSlabBytes = (std::size_t)bufs * sizeof(Page);
+	if (shmName.empty())
+	{
+		bufPool = static_cast<Page*>(mapSlab(bufPoolSlabBytes));
+	}
+	else
+	{
+		mapSharedPool(); // sets bufPool, shmDir and shmAdopted
+	}
+	bindSlabToNodes(bufPool, sizeof(Page));
+	if (!shmAdopted)
+	{ // an adopted segment keeps its frames byte-for-byte
+		for (FrameId i = 0; i < bufs; i++)
+		{
+			new (&bufPool[i]) Page();
+		}
+	}
+
+  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
+  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+
+	clearBufStats();
+
+	clockHands.resize(numPartitions);
+	a1Head.assign(numPartitions, FrameId(NO_FRAME));
+	a1Tail.assign(numPartitions, FrameId(NO_FRAME));
+	amHead.assign(numPartitions, FrameId(NO_FRAME));
+	amTail.assign(numPartitions, FrameId(NO_FRAME));
+	freeFrames.resize(numPartitions);
+	for (std::uint32_t p = 0; p < numPartitions; p++) {
+		// hand sits on the partition's last frame so the first advance
+		// lands on its first frame
+		clockHands[p] = partitionEnd(p) - 1;
+
+		// stock the free list back to front so the lowest frame is handed
+		// out first
+		const FrameId start = partitionStart(p);
+		const FrameId end = partitionEnd(p);
+		freeFrames[p].reserve(end - start);
+		for (FrameId i = end; i > start; i--) {
+			freeFrames[p].push_back(i - 1);
+		}
+	}
+
+	if (shmAdopted)
+	{
+		adoptSharedFrames();
+	}
+}
+
+/**
+ * Counts the machine's NUMA nodes from sysfs.
+ * @param none
+ * @return the number of nodes, or 1 if sysfs gives no answer
+ */
+std::uint32_t BufMgr::detectNumaNodes()
+{
+	std::uint32_t nodes = 0;
+	DIR* dir = ::opendir("/sys/devices/system/node");
+	if (dir == NULL) {
+		return 1;
+	}
+	struct dirent* entry;
+	while ((entry = ::readdir(dir)) != NULL) {
+		unsigned int id;
+		if (std::sscanf(entry->d_name, "node%u", &id) == 1) {
+			nodes++;
+		}
+	}
+	::closedir(dir);
+	return nodes > 0 ? nodes : 1;
+}
+
+/**
+ * Binds each partition's byte range of a frame-indexed slab to that
+ * partition's NUMA node (round robin over the nodes), rounded out to OS
+ * page boundaries. Best effort: on single-node machines, or if the mbind
+ * syscall is missing or refuses, the slab simply keeps the kernel's
+ * default placement.
+ * @param slab the slab covering all partitions
+ * @param elemBytes the size of one frame-indexed element in the slab
+ * @return void
+ */
+void BufMgr::bindSlabToNodes(void* slab, const std::size_t elemBytes) const
+{
+#if defined(__linux__) && defined(SYS_mbind)
+	const std::uint32_t nodes = detectNumaNodes();
+	if (nodes < 2 || numPartitions < 2) {
+		return;
+	}
+	const std::size_t osPage = (std::size_t)::sysconf(_SC_PAGESIZE);
+	const unsigned long MPOL_PREFERRED_POLICY = 1;
+	for (std::uint32_t p = 0; p < numPartitions; p++) {
+		std::size_t begin = (std::size_t)partitionStart(p) * elemBytes;
+		std::size_t end = (std::size_t)partitionEnd(p) * elemBytes;
+		begin = begin / osPage * osPage; // round out to whole OS pages
+		end = (end + osPage - 1) / osPage * osPage;
+		const unsigned long nodemask = 1ul << (p % nodes);
+		::syscall(SYS_mbind, (char*)slab + begin, end - begin,
+				MPOL_PREFERRED_POLICY, &nodemask, sizeof(nodemask) * 8 + 1, 0);
+	}
+#else
+	(void)slab;
+	(void)elemBytes;
+#endif
+}
+
+/**
+ * Flushes out all dirty pages and deallocates the buffer pool and the BufDesc table.
+ * @param none
+ * @return void
+ */
+BufMgr::~BufMgr() {
+	stopPrefetcher();
+	stopBackgroundWriter();
+	for (FrameId i = 0; i < capacityBufs; i++) {
+		if(bufDescTable[i].dirty == true) { // If dirtybit == true, flush the page
+			if (shmDir != NULL)
+			{ // write back in place so the directory entry survives, warm
+				bufDescTable[i].dirty = false;
+				markFrameDirty(i, false);
+				bufDescTable[i].file->writePage(bufPool[i]);
+			}
+			else
+			{
+				flushFile(bufDescTable[i].file);
+			}
+		}
+	}
+	for (FrameId i = 0; i < capacityBufs; i++) { // Deallocation
+		bufDescTable[i].~BufDesc();
+	}
+	unmapSlab(bufDescTable, descSlabBytes);
+	if (shmBase != NULL)
+	{ // the segment (and the warm frames in it) outlives this process
+		::munmap(shmBase, shmBytes);
+		::close(shmFd);
+	}
+	else
+	{
+		unmapSlab(bufPool, bufPoolSlabBytes);
+	}
+	delete hashTable;
+}
+
+/**
+ * Maps (creating or reattaching) the named shared-memory segment and
+ * points bufPool and shmDir into it.
+ * @return void
+ */
+void BufMgr::mapSharedPool()
+{
+	const std::size_t frameOffset = sharedFrameOffset(capacityBufs);
+	shmBytes = frameOffset + (std::size_t)capacityBufs * sizeof(Page);
+
+	shmFd = ::shm_open(shmName.c_str(), O_RDWR | O_CREAT, 0600);
+	if (shmFd < 0)
+	{
+		throw std::bad_alloc();
+	}
+
+	struct stat info;
+	bool reattach = ::fstat(shmFd, &info) == 0 &&
+			(std::size_t)info.st_size == shmBytes;
+	if (!reattach && ::ftruncate(shmFd, (off_t)shmBytes) != 0)
+	{
+		::close(shmFd);
+		throw std::bad_alloc();
+	}
+
+	shmBase = ::mmap(NULL, shmBytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+			shmFd, 0);
+	if (shmBase == MAP_FAILED)
+	{
+		::close(shmFd);
+		throw std::bad_alloc();
+	}
+
+	SharedPoolHeader* header = static_cast<SharedPoolHeader*>(shmBase);
+	if (reattach &&
+			header->magic == SHARED_POOL_MAGIC &&
+			header->version == SHARED_POOL_VERSION &&
+			header->capacity == capacityBufs &&
+			header->pageSize == Page::SIZE)
+	{
+		shmAdopted = true;
+	}
+	else
+	{ // fresh (or mismatched) segment: start cold
+		std::memset(shmBase, 0, frameOffset);
+		header->magic = SHARED_POOL_MAGIC;
+		header->version = SHARED_POOL_VERSION;
+		header->capacity = capacityBufs;
+		header->pageSize = Page::SIZE;
+		shmAdopted = false;
+	}
+
+	shmDir = static_cast<char*>(shmBase) + sizeof(SharedPoolHeader);
+	bufPool = reinterpret_cast<Page*>(static_cast<char*>(shmBase) + frameOffset);
+}
+
+/**
+ * Installs every frame the shared directory records as valid and clean
+ * into the hash table, descriptors and policy lists, reopening the named
+ * files; no page is read from disk.
+ * @return void
+ */
+void BufMgr::adoptSharedFrames()
+{
+	SharedFrameDir* dir = static_cast<SharedFrameDir*>(shmDir);
+	for (FrameId i = 0; i < numBufs; i++)
+	{
+		if (!dir[i].valid || dir[i].dirty)
+		{ // dirty frames may be newer than disk; drop rather than guess
+			dir[i].valid = 0;
+			continue;
+		}
+		std::shared_ptr<File> file;
+		try
+		{
+			file = std::make_shared<File>(File::open(dir[i].filename));
+		}
+		catch (FileNotFoundException&)
+		{
+			dir[i].valid = 0;
+			continue;
+		}
+
+		FrameId existing;
+		if (hashTable->tryLookup(file.get(), dir[i].pageNo, existing))
+		{ // duplicate directory entry; keep the first
+			dir[i].valid = 0;
+			continue;
+		}
+
+		adoptFiles.push_back(file);
+		hashTable->insert(file.get(), dir[i].pageNo, i);
+		bufDescTable[i].Set(file.get(), dir[i].pageNo);
+		bufDescTable[i].pinCnt = 0; // resident but not pinned
+		fileIndexAdd(file.get(), i);
+		policyPagedIn(i);
+
+		std::vector<FrameId>& free = freeFrames[partitionOfFrame(i)];
+		free.erase(std::find(free.begin(), free.end(), i));
+	}
+}
+
+/**
+ * Unlinks a shared-memory pool segment.
+ * @param shmName name of the segment
+ * @return void
+ */
+void BufMgr::removeSharedPool(const std::string& shmName)
+{
+	::shm_unlink(shmName.c_str());
+}
+
+/**
+ * Records frame identity in the shared directory after a Set().
+ * @param frame the frame just set up
+ * @return void
+ */
+void BufMgr::publishFrame(const FrameId frame)
+{
+	if (shmDir == NULL)
+	{
+		return;
+	}
+	SharedFrameDir& entry = static_cast<SharedFrameDir*>(shmDir)[frame];
+	const std::string& name = bufDescTable[frame].file->filename();
+	if (name.size() >= sizeof(entry.filename))
+	{ // name doesn't fit; this frame just won't survive a restart
+		entry.valid = 0;
+		return;
+	}
+	entry.valid = 0; // invalid while the entry is inconsistent
+	std::strcpy(entry.filename, name.c_str());
+	entry.pageNo = bufDescTable[frame].pageNo;
+	entry.dirty = 0;
+	entry.valid = 1;
+}
+
+/**
+ * Marks a frame's shared directory entry invalid.
+ * @param frame the frame being evicted or cleared
+ * @return void
+ */
+void BufMgr::unpublishFrame(const FrameId frame)
+{
+	if (shmDir == NULL)
+	{
+		return;
+	}
+	static_cast<SharedFrameDir*>(shmDir)[frame].valid = 0;
+}
+
+/**
+ * Tracks the dirty flag in the shared directory.
+ * @param frame the frame whose dirty state changed
+ * @param dirty the new dirty state
+ * @return void
+ */
+void BufMgr::markFrameDirty(const FrameId frame, const bool dirty)
+{
+	if (shmDir == NULL)
+	{
+		return;
+	}
+	static_cast<SharedFrameDir*>(shmDir)[frame].dirty = dirty ? 1 : 0;
+}
+
+/**
+ * Maps an anonymous slab rounded up to 2MB and requests huge page backing
+ * where the kernel supports it.
+ * @param bytes requested size; rounded up in place to the mapped size
+ * @return the mapping
+ * @throws std::bad_alloc, if the mapping cannot be established
+ */
+void* BufMgr::mapSlab(std::size_t& bytes)
+{
+	const std::size_t hugePage = 2u * 1024u * 1024u;
+	bytes = (bytes + hugePage - 1) / hugePage * hugePage;
+
+	void* slab = ::mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (slab == MAP_FAILED) {
+		throw std::bad_alloc();
+	}
+#ifdef MADV_HUGEPAGE
+	// best effort; plain 4KB pages still work, just with more TLB misses
+	::madvise(slab, bytes, MADV_HUGEPAGE);
+#endif
+	return slab;
+}
+
+/**
+ * Unmaps a slab obtained from mapSlab().
+ * @param slab the mapping
+ * @param bytes mapped size as adjusted by mapSlab()
+ * @return void
+ */
+void BufMgr::unmapSlab(void* slab, const std::size_t bytes)
+{
+	::munmap(slab, bytes);
+}
+
+/**
+ * Advances a partition's clock hand to the next frame of the partition.
+ * @param partition the partition whose hand to advance
+ * @return void
+ */
+void BufMgr::advanceClock(const std::uint32_t partition)
+{
+	if(clockHands[partition] == partitionEnd(partition) - 1) {
+		clockHands[partition] = partitionStart(partition);
+	}
+	else {
+		clockHands[partition]++;
+	}
+
+	if (writerRunning) {
+		writerCv.notify_one(); // let the background writer keep its lead
+	}
+}
+
+/**
+ * Starts the background writer thread.
+ * @param none
+ * @return void
+ */
+void BufMgr::startBackgroundWriter()
+{
+	if (writerRunning) {
+		return;
+	}
+	writerRunning = true;
+	writerThread = std::thread(&BufMgr::backgroundWriterMain, this);
+}
+
+/**
+ * Stops and joins the background writer thread if running.
+ * @param none
+ * @return void
+ */
+void BufMgr::stopBackgroundWriter()
+{
+	if (!writerRunning) {
+		return;
+	}
+	writerRunning = false;
+	writerCv.notify_one();
+	writerThread.join();
+}
+
+/**
+ * Snapshots the identity of every resident page to a sidecar file, one
+ * tab-separated "filename<TAB>pageNo" line per valid frame, sorted so a
+ * later warmStart() replays them as sequential reads. The snapshot is
+ * written to a temporary and renamed into place so readers never see a
+ * torn sidecar.
+ * @param path   sidecar file to write
+ * @return void
+ */
+void BufMgr::saveWarmStartState(const std::string& path)
+{
+	std::vector<std::pair<std::string, PageId> > resident;
+	{
+		std::lock_guard<std::mutex> allocLock(allocLatch);
+		for (FrameId i = 0; i < numBufs; i++)
+		{
+			BufDesc* desc = &bufDescTable[i];
+			if (desc->valid && desc->file != NULL)
+			{
+				resident.push_back(std::make_pair(desc->file->filename(),
+				                                  desc->pageNo));
+			}
+		}
+	}
+	std::sort(resident.begin(), resident.end());
+
+	const std::string tmpPath = path + ".tmp";
+	std::ofstream out(tmpPath.c_str(), std::ios::trunc);
+	if (!out.is_open())
+	{
+		return;
+	}
+	for (std::size_t i = 0; i < resident.size(); i++)
+	{
+		out << resident[i].first << '\t' << resident[i].second << '\n';
+	}
+	out.close();
+	if (out.fail())
+	{
+		std::remove(tmpPath.c_str());
+		return;
+	}
+	std::rename(tmpPath.c_str(), path.c_str());
+}
+
+/**
+ * Reloads the pages named in a warm-start sidecar. Each file is opened
+ * once and kept open for the life of the buffer manager; its pages are
+ * read in page-number order and immediately unpinned, so they sit in the
+ * pool ready for the first real requests. Files or pages that no longer
+ * exist are skipped; loading stops once the pool is full.
+ * @param path   sidecar file written by saveWarmStartState()
+ * @return void
+ */
+void BufMgr::warmStart(const std::string& path)
+{
+	std::ifstream in(path.c_str());
+	if (!in.is_open())
+	{
+		return;
+	}
+
+	std::map<std::string, std::vector<PageId> > pagesByFile;
+	std::string line;
+	while (std::getline(in, line))
+	{
+		const std::size_t tab = line.find('\t');
+		if (tab == std::string::npos)
+		{
+			continue;
+		}
+		const PageId pageNo = (PageId)strtoul(line.c_str() + tab + 1, NULL, 10);
+		if (pageNo != Page::INVALID_NUMBER)
+		{
+			pagesByFile[line.substr(0, tab)].push_back(pageNo);
+		}
+	}
+
+	std::uint32_t loaded = 0;
+	for (std::map<std::string, std::vector<PageId> >::iterator it =
+	         pagesByFile.begin();
+	     it != pagesByFile.end() && loaded < numBufs; ++it)
+	{
+		std::shared_ptr<File> file;
+		try
+		{
+			file = std::shared_ptr<File>(new File(File::open(it->first)));
+		}
+		catch (FileNotFoundException& e)
+		{
+			continue;
+		}
+		warmStartFiles.push_back(file);
+
+		std::vector<PageId>& pages = it->second;
+		std::sort(pages.begin(), pages.end());
+		for (std::size_t i = 0; i < pages.size() && loaded < numBufs; i++)
+		{
+			if (i > 0 && pages[i] == pages[i - 1])
+			{
+				continue;
+			}
+			try
+			{
+				Page* page;
+				readPage(file.get(), pages[i], page);
+				unPinPage(file.get(), pages[i], false);
+				loaded++;
+			}
+			catch (InvalidPageException& e)
+			{
+				// page was deleted since the snapshot; skip it
+			}
+			catch (BufferExceededException& e)
+			{
+				return;
+			}
+		}
+	}
+}
+
+/**
+ * Background writer main loop. Sweeps a window of frames just ahead of the
+ * clock hand and writes back dirty unpinned frames, so eviction at the
+ * clock hand is usually a clean in-memory operation. Frames are inspected
+ * with try_lock so the writer never blocks foreground pins.
+ * @param none
+ * @return void
+ */
+void BufMgr::backgroundWriterMain()
+{
+	while (writerRunning)
+	{
+		{
+			std::unique_lock<std::mutex> lock(writerMutex);
+			writerCv.wait_for(lock, std::chrono::milliseconds(10));
+		}
+		if (!writerRunning) {
+			break;
+		}
+
+		for (std::uint32_t p = 0; p < numPartitions && writerRunning; p++)
+		{
+		const FrameId start = partitionStart(p);
+		const FrameId size = partitionEnd(p) - start;
+
+		// sweep up to 1/16th of the partition ahead of its clock hand, at
+		// least 8 frames, so the writer keeps a useful lead without
+		// chasing its tail
+		std::uint32_t window = size / 16;
+		if (window < 8) {
+			window = 8;
+		}
+		if (window > size) {
+			window = size;
+		}
+
+		const FrameId hand = clockHands[p];
+		for (std::uint32_t i = 1; i <= window && writerRunning; i++)
+		{
+			const FrameId frame = start + (hand - start + i) % size;
+			BufDesc& desc = bufDescTable[frame];
+
+			if (!desc.valid || !desc.dirty || desc.pinCnt > 0) {
+				continue;
+			}
+
+			std::unique_lock<std::mutex> frameLock(desc.latch, std::try_to_lock);
+			if (!frameLock.owns_lock()) {
+				continue; // never stall behind foreground work
+			}
+			if (!desc.valid || !desc.dirty || desc.pinCnt > 0) {
+				continue;
+			}
+
+			// A reader may pin and redirty the page while we write; the write
+			// is then stale but harmless, as the dirty bit it sets afterwards
+			// forces another writeback.
+			desc.dirty = false;
+			markFrameDirty(frame, false);
+			desc.file->writePage(bufPool[frame]);
+			statsShard().diskwrites.fetch_add(1, std::memory_order_relaxed);
+		}
+		}
+	}
+}
+
+/**
+ * Allocates a free frame using the selected replacement policy; if necessary, writing a dirty page back
+	to disk. Throws BufferExceededException if all buffer frames are pinned. This private
+	method will get called by the readPage() and allocPage() methods described below. The
+	victim search starts in the page's home partition and steals from the other
+	partitions only when home has no evictable frame.
+ * @param frame pointer to newly allocated frame
+ * @param partition the page's home partition
+ * @return pointer to the newly allocated frame
+ * @throws BufferExceededException, if all buffer frames are pinned
+ */
+void BufMgr::allocBuf(FrameId & frame, const std::uint32_t partition)
+{
+	StatsShard& stats = statsShard();
+	stats.victimSearches.fetch_add(1, std::memory_order_relaxed);
+	const std::uint64_t searchStart = readCycles();
+	std::uint64_t inspected = 0;
+	std::uint64_t pinSkips = 0;
+	bool found = false;
+
+	// search the page's home partition first so frames (and the memory
+	// behind them) stay node-local, stealing from the others only when
+	// home has nothing evictable
+	for (std::uint32_t i = 0; i < numPartitions && !found; i++)
+	{
+		const std::uint32_t p = (partition + i) % numPartitions;
+		found = policy == POLICY_TWO_Q
+				? allocBufTwoQIn(frame, p, inspected, pinSkips)
+				: allocBufClockIn(frame, p, inspected, pinSkips);
+	}
+
+	stats.framesInspected.fetch_add(inspected, std::memory_order_relaxed);
+	stats.pinSkips.fetch_add(pinSkips, std::memory_order_relaxed);
+	// power-of-two buckets, same shape as the miss-latency histogram
+	stats.sweepLength[latencyBucket(inspected)].fetch_add(
+			1, std::memory_order_relaxed);
+	stats.victimSearchCycles.fetch_add(readCycles() - searchStart,
+			std::memory_order_relaxed);
+
+	if (!found)
+	{
+		stats.allocFailures.fetch_add(1, std::memory_order_relaxed);
+		// exceeds buffer size or frames are all pinned
+		throw BufferExceededException();
+	}
+}
+
+/**
+ * Clock victim search confined to one partition; if necessary, writing a
+ * dirty page back to disk. Frames known to be empty are handed out
+ * without a sweep, so a cold pool fills in O(1) per page regardless of
+ * numBufs.
+ * @param frame reference through which the allocated frame is returned
+ * @param partition the partition to search
+ * @return true if a frame was allocated, false if every frame is pinned
+ */
+bool BufMgr::allocBufClockIn(FrameId & frame, const std::uint32_t partition,
+		std::uint64_t & inspected, std::uint64_t & pinSkips)
+{
+	if (!freeFrames[partition].empty())
+	{
+		frame = freeFrames[partition].back();
+		freeFrames[partition].pop_back();
+		return true;
+	}
+
+	// budget of two visits per frame: the first can only clear a refbit,
+	// the second evicts, so only an all-pinned (or all-retired) partition
+	// exhausts it
+	const std::uint32_t partitionFrames =
+			partitionEnd(partition) - partitionStart(partition);
+	std::uint32_t budget = 0;
+
+	while(budget++ < 2 * partitionFrames + 2)
+	{
+
+		this->advanceClock(partition); //Advance Clock Pointer
+		frame = clockHands[partition]; // set frame to current clockhand
+		inspected++;
+
+		if (frame >= numBufs)
+		{ // retired by resize(); not in circulation
+			continue;
+		}
+
+		// take the frame latch so a concurrent reader can't pin this frame
+		// while we are deciding whether to evict it
+		std::lock_guard<std::mutex> frameLock(bufDescTable[frame].latch);
+
+		if (bufDescTable[frame].valid == false)
+		{
+			if (bufDescTable[frame].pinCnt > 0)
+			{ // claimed by a batch fault still waiting on its read
+				pinSkips++;
+				continue;
+			}
+			return true;
+		} else {
+
+			if (bufDescTable[frame].refbit == true)
+			{ //Checks if refbit has been set
+				bufDescTable[frame].refbit = false;
+				continue;
+			} else {
+
+				if(bufDescTable[frame].pinCnt > 0)
+				{ //Checks if Page has been pinned
+					pinSkips++;
+					continue;
+				}
+
+				evictFrame(frame);
+				return true;
+			}
+		}
+	}
+
+	return false; // this partition has no evictable frame
+}
+
+/**
+ * Writes the frame back to disk if dirty, removes its hash table entry and
+ * marks it invalid. Caller holds the allocation latch and the frame latch.
+ * @param frame the frame to evict
+ * @return void
+ */
+void BufMgr::evictFrame(const FrameId frame)
+{
+	if(bufDescTable[frame].dirty == true)
+	{ //Checks Dirty Bit
+		bufDescTable[frame].dirty = false;
+		// write page back to disk
+		bufDescTable[frame].file->writePage(bufPool[frame]);
+		statsShard().diskwrites.fetch_add(1, std::memory_order_relaxed);
+		statsShard().evictionsDirty.fetch_add(1, std::memory_order_relaxed);
+	}
+	else
+	{
+		statsShard().evictionsClean.fetch_add(1, std::memory_order_relaxed);
+	}
+	statsShard().evictions.fetch_add(1, std::memory_order_relaxed);
+	if (victimCache.enabled())
+	{ // dirty pages were just written back, so the copy matches disk
+		victimCache.put(bufDescTable[frame].file->fileId(),
+				bufDescTable[frame].pageNo, bufPool[frame]);
+	}
+	try{ //remove entry from hashtable
+		hashTable->remove(bufDescTable[frame].file, bufDescTable[frame].pageNo);
+	} catch(HashNotFoundException &e){
+
+	}
+	fileIndexRemove(bufDescTable[frame].file, frame);
+	unpublishFrame(frame);
+	// mark invalid so a reader that looked the frame up before the
+	// remove fails its re-validation instead of pinning a victim
+	bufDescTable[frame].valid = false;
+}
+
+/**
+ * Victim search for the 2Q policy, confined to one partition. Free frames
+ * are handed out first. Then the head of the probation FIFO (A1) is
+ * considered: frames re-referenced while on probation are promoted to the
+ * protected LRU (Am) instead of evicted, so one-pass scans are evicted
+ * from probation without touching the protected set. If probation is
+ * empty the protected LRU tail is evicted, with re-referenced frames
+ * rotated back to the MRU position.
+ * @param frame reference through which the allocated frame is returned
+ * @param partition the partition to search
+ * @return true if a frame was allocated, false if every frame is pinned
+ */
+bool BufMgr::allocBufTwoQIn(FrameId & frame, const std::uint32_t partition,
+		std::uint64_t & inspected, std::uint64_t & pinSkips)
+{
+	// generous rotation budget; only an all-pinned partition exhausts it
+	const std::uint32_t partitionFrames =
+			partitionEnd(partition) - partitionStart(partition);
+	std::uint32_t budget = 0;
+	const std::uint32_t limit = 2 * partitionFrames + 2;
+
+	while (budget++ < limit)
+	{
+		if (!freeFrames[partition].empty())
+		{
+			frame = freeFrames[partition].back();
+			freeFrames[partition].pop_back();
+			return true;
+		}
+
+		FrameId candidate;
+		bool fromA1;
+		if (a1Head[partition] != NO_FRAME) {
+			candidate = a1Head[partition];
+			fromA1 = true;
+		} else if (amTail[partition] != NO_FRAME) {
+			candidate = amTail[partition];
+			fromA1 = false;
+		} else {
+			break; // no frames tracked at all
+		}
+
+		std::lock_guard<std::mutex> frameLock(bufDescTable[candidate].latch);
+		inspected++;
+
+		if (bufDescTable[candidate].rereferenced.exchange(false))
+		{ // accessed while resident: (re)establish protected status
+			listRemove(candidate);
+			listPushAmHead(candidate);
+			continue;
+		}
+
+		if (bufDescTable[candidate].pinCnt > 0)
+		{ // pinned frames rotate out of the victim position
+			pinSkips++;
+			listRemove(candidate);
+			if (fromA1)
+				listPushA1Tail(candidate);
+			else
+				listPushAmHead(candidate);
+			continue;
+		}
+
+		listRemove(candidate);
+		evictFrame(candidate);
+		frame = candidate;
+		return true;
+	}
+
+	return false; // this partition has no evictable frame
+}
+
+/**
+ * Unlinks a frame from whichever 2Q queue it is on. Caller holds the
+ * allocation latch.
+ * @param frame the frame to unlink
+ * @return void
+ */
+void BufMgr::listRemove(const FrameId frame)
+{
+	BufDesc& desc = bufDescTable[frame];
+	if (desc.queue == QUEUE_NONE) {
+		return;
+	}
+
+	if (desc.prev != NO_FRAME)
+		bufDescTable[desc.prev].next = desc.next;
+	if (desc.next != NO_FRAME)
+		bufDescTable[desc.next].prev = desc.prev;
+
+	const std::uint32_t p = partitionOfFrame(frame);
+	if (desc.queue == QUEUE_A1) {
+		if (a1Head[p] == frame) a1Head[p] = desc.next;
+		if (a1Tail[p] == frame) a1Tail[p] = desc.prev;
+	} else {
+		if (amHead[p] == frame) amHead[p] = desc.next;
+		if (amTail[p] == frame) amTail[p] = desc.prev;
+	}
+
+	desc.queue = QUEUE_NONE;
+	desc.prev = desc.next = NO_FRAME;
+}
+
+/**
+ * Links a frame at the tail of the probation FIFO. Caller holds the
+ * allocation latch.
+ * @param frame the frame to link
+ * @return void
+ */
+void BufMgr::listPushA1Tail(const FrameId frame)
+{
+	BufDesc& desc = bufDescTable[frame];
+	const std::uint32_t p = partitionOfFrame(frame);
+	desc.queue = QUEUE_A1;
+	desc.prev = a1Tail[p];
+	desc.next = NO_FRAME;
+	if (a1Tail[p] != NO_FRAME)
+		bufDescTable[a1Tail[p]].next = frame;
+	a1Tail[p] = frame;
+	if (a1Head[p] == NO_FRAME)
+		a1Head[p] = frame;
+}
+
+/**
+ * Links a frame at the MRU head of the protected LRU. Caller holds the
+ * allocation latch.
+ * @param frame the frame to link
+ * @return void
+ */
+void BufMgr::listPushAmHead(const FrameId frame)
+{
+	BufDesc& desc = bufDescTable[frame];
+	const std::uint32_t p = partitionOfFrame(frame);
+	desc.queue = QUEUE_AM;
+	desc.prev = NO_FRAME;
+	desc.next = amHead[p];
+	if (amHead[p] != NO_FRAME)
+		bufDescTable[amHead[p]].prev = frame;
+	amHead[p] = frame;
+	if (amTail[p] == NO_FRAME)
+		amTail[p] = frame;
+}
+
+/**
+ * Policy bookkeeping after a page lands in a frame: under 2Q new pages
+ * start on probation. Caller holds the allocation latch.
+ * @param frame the frame that was paged in
+ * @return void
+ */
+void BufMgr::policyPagedIn(const FrameId frame)
+{
+	if (policy != POLICY_TWO_Q) {
+		return;
+	}
+	bufDescTable[frame].rereferenced = false;
+	listPushA1Tail(frame);
+}
+
+/**
+ * Policy bookkeeping after a frame is emptied outside a victim search
+ * (disposePage, flushFile). Caller holds the allocation latch.
+ * @param frame the frame that was emptied
+ * @return void
+ */
+void BufMgr::policyRemoved(const FrameId frame)
+{
+	if (policy == POLICY_TWO_Q) {
+		listRemove(frame);
+	}
+	freeFrames[partitionOfFrame(frame)].push_back(frame);
+}
+
+/**
+ * Adds a frame to the owning file's frame list. Caller holds the
+ * allocation latch.
+ * @param file the file owning the page
+ * @param frame the frame holding the page
+ * @return void
+ */
+void BufMgr::fileIndexAdd(const File* file, const FrameId frame)
+{
+	fileFrames[file->fileId()].push_back(frame);
+}
+
+/**
+ * Removes a frame from the owning file's frame list. Caller holds the
+ * allocation latch.
+ * @param file the file that owned the page
+ * @param frame the frame that held the page
+ * @return void
+ */
+void BufMgr::fileIndexRemove(const File* file, const FrameId frame)
+{
+	std::unordered_map<FileId, std::vector<FrameId> >::iterator it =
+			fileFrames.find(file->fileId());
+	if (it == fileFrames.end()) {
+		return;
+	}
+	std::vector<FrameId>& frames = it->second;
+	for (std::size_t i = 0; i < frames.size(); i++) {
+		if (frames[i] == frame) {
+			frames[i] = frames.back();
+			frames.pop_back();
+			break;
+		}
+	}
+	if (frames.empty()) {
+		fileFrames.erase(it);
+	}
+}
+
+/**
+ * First check whether the page is already in the buffer pool by invoking the lookup() method,
+	which may throw HashNotFoundException when page is not in the buffer pool, on the
+	hashtable to get a frame number. There are two cases to be handled depending on the
+	outcome of the lookup() call:
+ 		Case 1: Page is not in the buffer pool. Call allocBuf() to allocate a buffer frame and
+			then call the method file->readPage() to read the page from disk into the buffer pool
+			frame. Next, insert the page into the hashtable. Finally, invoke Set() on the frame to
+			set it up properly. Set() will leave the pinCnt for the page set to 1. Return a pointer
+			to the frame containing the page via the page parameter.
+ 		Case 2: Page is in the buffer pool. In this case set the appropriate refbit, increment
+			the pinCnt for the page, and then return a pointer to the frame containing the page
+			via the page parameter.
+ * @param file the File instance to contain the page to read
+ * @param pageNo the page number of the page to read
+ * @param page pointer to the frame containing the newly read page
+ * @return pointer to the frame containing the page
+ */
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+{
+	readPageInternal(file, pageNo, page, homePartition(file, pageNo));
+}
+
+/**
+ * As readPage(File*, PageId, Page*&), but a miss faults the page into the
+ * named partition's frames. Unknown names fall back to the page's default
+ * placement; hits are served wherever the page already lives.
+ * @param file the file to read from
+ * @param pageNo the page number to read
+ * @param page pointer to the frame containing the newly read page
+ * @param partition name of the partition to fault the page into
+ * @return void
+ */
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page,
+		const std::string& partition)
+{
+	readPageInternal(file, pageNo, page,
+			hintPartition(partition, file, pageNo));
+}
+
+/**
+ * As readPage(File*, PageId, Page*&), but returns an RAII handle for the
+ * pin so release needs no hash table lookup.
+ * @param file the file to read from
+ * @param pageNo the page number to read
+ * @return handle owning one pin on the page
+ */
+PageHandle BufMgr::readPage(File* file, const PageId pageNo)
+{
+	Page* page = NULL;
+	const FrameId frameNo = readPageInternal(file, pageNo, page,
+			homePartition(file, pageNo));
+	if (frameNo == NO_FRAME)
+	{
+		if (page != NULL)
+		{
+			// mapped-file view; the handle carries no pin to release
+			return PageHandle(NULL, 0, page);
+		}
+		return PageHandle();
+	}
+	return PageHandle(this, frameNo, page);
+}
+
+/**
+ * Shared body of the readPage overloads; pins the page and reports the
+ * frame holding it.
+ * @param file the file to read from
+ * @param pageNo the page number to read
+ * @param page reference through which the pinned page is returned
+ * @return the frame holding the page, or NO_FRAME if no frame was evictable
+ */
+FrameId BufMgr::readPageInternal(File* file, const PageId pageNo, Page*& page,
+		const std::uint32_t partition)
+{
+	// mmap-backed files are served straight out of the shared mapping:
+	// no frame, no hash table entry, no copy. A later unPinPage for the
+	// page no-ops through its hash table miss.
+	if (file->isMapped())
+	{
+		page = const_cast<Page*>(file->pageView(pageNo));
+		StatsShard& stats = statsShard();
+		stats.accesses.fetch_add(1, std::memory_order_relaxed);
+		stats.hits.fetch_add(1, std::memory_order_relaxed);
+		return NO_FRAME;
+	}
+
+	FrameId frameNo = 0; // to hold the frame num returned by lookup()
+
+	while (true)
+	{
+		if (hashTable->tryLookup(file, pageNo, frameNo))
+		{
+			{
+				// re-validate under the frame latch and only then pin: the
+				// victim search checks pinCnt under this latch, so a pin
+				// taken before validating could interleave with an eviction
+				// and be clobbered by the miss path's Set()
+				std::lock_guard<std::mutex> frameLock(bufDescTable[frameNo].latch);
+				// compare interned file ids, not File pointers: distinct File
+				// objects (copies, or warm-start handles) may alias one file
+				if (bufDescTable[frameNo].valid &&
+						bufDescTable[frameNo].file->fileId() == file->fileId() &&
+						bufDescTable[frameNo].pageNo == pageNo)
+				{
+					bufDescTable[frameNo].pinCnt++; // increment pin count
+					bufDescTable[frameNo].refbit = true; // set reference bit to true
+					bufDescTable[frameNo].rereferenced = true; // 2Q promotion hint
+					page = &bufPool[frameNo]; //return pointer to frame containing page
+					StatsShard& stats = statsShard();
+					stats.accesses.fetch_add(1, std::memory_order_relaxed);
+					stats.hits.fetch_add(1, std::memory_order_relaxed);
+					return frameNo;
+				}
+			}
+
+			// lost the race with an eviction; start over
+			continue;
+		}
+
+		// page miss; frame allocation is serialized behind allocLatch
+		std::lock_guard<std::mutex> allocLock(allocLatch);
+
+		// another thread may have brought the page in while we waited
+		if (hashTable->tryLookup(file, pageNo, frameNo))
+			continue;
+
+		StatsShard& stats = statsShard();
+		stats.accesses.fetch_add(1, std::memory_order_relaxed);
+		stats.misses.fetch_add(1, std::memory_order_relaxed);
+		const std::chrono::steady_clock::time_point missStart =
+				std::chrono::steady_clock::now();
+
+		bool fromVictimCache = false;
+		try {
+
+			allocBuf(frameNo, partition); // alloc a buffer frame for page
+			// a recently evicted page decompresses out of the victim cache
+			// instead of paying a disk read
+			fromVictimCache = victimCache.get(file->fileId(), pageNo, bufPool[frameNo]);
+			if (!fromVictimCache)
+				file->readPage(pageNo, bufPool[frameNo]); // read page straight into the frame
+			hashTable->insert(file, pageNo, frameNo); // update hashtable
+			bufDescTable[frameNo].Set(file, pageNo); // set up frame properly
+			publishFrame(frameNo);
+			fileIndexAdd(file, frameNo);
+			policyPagedIn(frameNo);
+			page = &bufPool[frameNo];
+
+		} catch(BufferExceededException &) {
+			// do nothing for exceptions
+			return NO_FRAME;
+		}
+
+		if (!fromVictimCache)
+			stats.diskreads.fetch_add(1, std::memory_order_relaxed);
+		const std::uint64_t micros =
+				std::chrono::duration_cast<std::chrono::microseconds>(
+						std::chrono::steady_clock::now() - missStart).count();
+		stats.missLatency[latencyBucket(micros)].fetch_add(
+				1, std::memory_order_relaxed);
+		return frameNo;
+	}
+}
+
+/**
+ * As readPage, but non-blocking on a miss: the returned future resolves
+ * to the pinned page once the read completes on the I/O engine. The hit
+ * path (and mapped files, and victim cache hits) resolves the future
+ * before returning. On a miss the frame is claimed pinned-but-invalid,
+ * exactly as readPages does for its batch, so the clock sweep passes
+ * over it; the hash table entry appears only when the data has arrived,
+ * and if another thread loaded the page first the claimed frame is
+ * released and the future resolves to the winner's frame instead.
+ * @param file the file to read from
+ * @param pageNo the page number to read
+ * @return future resolving to a pointer to the pinned page
+ */
+std::future<Page*> BufMgr::readPageAsync(File* file, const PageId pageNo)
+{
+	std::shared_ptr<std::promise<Page*> > done =
+			std::make_shared<std::promise<Page*> >();
+	std::future<Page*> token = done->get_future();
+
+	if (file->isMapped())
+	{
+		StatsShard& stats = statsShard();
+		stats.accesses.fetch_add(1, std::memory_order_relaxed);
+		stats.hits.fetch_add(1, std::memory_order_relaxed);
+		done->set_value(const_cast<Page*>(file->pageView(pageNo)));
+		return token;
+	}
+
+	FrameId frameNo = 0;
+	while (true)
+	{
+		if (hashTable->tryLookup(file, pageNo, frameNo))
+		{ // hit path, as in readPageInternal: re-validate, then pin
+			{
+				std::lock_guard<std::mutex> frameLock(bufDescTable[frameNo].latch);
+				if (bufDescTable[frameNo].valid &&
+						bufDescTable[frameNo].file->fileId() == file->fileId() &&
+						bufDescTable[frameNo].pageNo == pageNo)
+				{
+					bufDescTable[frameNo].pinCnt++;
+					bufDescTable[frameNo].refbit = true;
+					bufDescTable[frameNo].rereferenced = true;
+					StatsShard& stats = statsShard();
+					stats.accesses.fetch_add(1, std::memory_order_relaxed);
+					stats.hits.fetch_add(1, std::memory_order_relaxed);
+					done->set_value(&bufPool[frameNo]);
+					return token;
+				}
+			}
+			continue;
+		}
+
+		std::lock_guard<std::mutex> allocLock(allocLatch);
+
+		// another thread may have brought the page in while we waited
+		if (hashTable->tryLookup(file, pageNo, frameNo))
+			continue;
+
+		StatsShard& stats = statsShard();
+		stats.accesses.fetch_add(1, std::memory_order_relaxed);
+		stats.misses.fetch_add(1, std::memory_order_relaxed);
+
+		try {
+			allocBuf(frameNo, homePartition(file, pageNo));
+		} catch (BufferExceededException&) {
+			done->set_exception(std::current_exception());
+			return token;
+		}
+
+		if (victimCache.get(file->fileId(), pageNo, bufPool[frameNo]))
+		{ // no disk round-trip needed; resolve right here
+			hashTable->insert(file, pageNo, frameNo);
+			bufDescTable[frameNo].Set(file, pageNo);
+			publishFrame(frameNo);
+			fileIndexAdd(file, frameNo);
+			policyPagedIn(frameNo);
+			done->set_value(&bufPool[frameNo]);
+			return token;
+		}
+
+		// claim the frame as pinned-but-invalid across the engine hop; the
+		// clock sweep skips such frames (see allocBuf)
+		bufDescTable[frameNo].pinCnt = 1;
+		break;
+	}
+
+	BufMgr* self = this;
+	IoEngine::instance().submit([self, file, pageNo, frameNo, done]() {
+		try {
+			file->readPage(pageNo, self->bufPool[frameNo]);
+		} catch (...) {
+			std::lock_guard<std::mutex> allocLock(self->allocLatch);
+			self->bufDescTable[frameNo].pinCnt = 0; // release the claim
+			done->set_exception(std::current_exception());
+			return;
+		}
+
+		std::lock_guard<std::mutex> allocLock(self->allocLatch);
+
+		FrameId existing;
+		if (self->hashTable->tryLookup(file, pageNo, existing))
+		{ // lost the race with a concurrent load; hand back our frame and
+			// pin the winner's, which cannot be evicted while we hold the
+			// allocation latch
+			self->bufDescTable[frameNo].pinCnt = 0;
+			self->bufDescTable[existing].pinCnt++;
+			self->bufDescTable[existing].refbit = true;
+			self->bufDescTable[existing].rereferenced = true;
+			done->set_value(&self->bufPool[existing]);
+			return;
+		}
+
+		self->hashTable->insert(file, pageNo, frameNo);
+		self->bufDescTable[frameNo].Set(file, pageNo);
+		self->publishFrame(frameNo);
+		self->fileIndexAdd(file, frameNo);
+		self->policyPagedIn(frameNo);
+		self->statsShard().diskreads.fetch_add(1, std::memory_order_relaxed);
+		done->set_value(&self->bufPool[frameNo]);
+	});
+
+	return token;
+}
+
+/**
+ * Pins every page in <pageNos> with one residency pass and one trip
+ * through the allocation latch for the misses. Hits pin exactly as
+ * readPage does; misses get their frames up front, are read concurrently
+ * on the I/O engine, and are published together. The statistics counters
+ * are touched once per batch instead of once per page. All-or-nothing:
+ * any failure releases every pin the batch took before rethrowing.
+ * @param file the file to read from
+ * @param pageNos the page numbers to pin
+ * @param count the number of pages in the batch
+ * @param pages receives one pinned page pointer per entry
+ * @return void
+ * @throws BufferExceededException, if a miss finds no evictable frame
+ * @throws InvalidPageException, if one of the pages does not exist
+ */
+void BufMgr::readPages(File* file, const PageId* pageNos,
+		const std::size_t count, Page** pages)
+{
+	if (count == 0)
+		return;
+
+	StatsShard& stats = statsShard();
+
+	if (file->isMapped())
+	{
+		for (std::size_t i = 0; i < count; i++)
+			pages[i] = const_cast<Page*>(file->pageView(pageNos[i]));
+		stats.accesses.fetch_add(count, std::memory_order_relaxed);
+		stats.hits.fetch_add(count, std::memory_order_relaxed);
+		return;
+	}
+
+	std::vector<FrameId> pinnedFrames; // every pin the batch holds, for unwind
+	std::vector<std::size_t> missing;
+	std::uint64_t hitCount = 0;
+
+	// pass 1: pin the resident pages, remember the rest
+	for (std::size_t i = 0; i < count; i++)
+	{
+		pages[i] = NULL;
+		FrameId frameNo;
+		while (hashTable->tryLookup(file, pageNos[i], frameNo))
+		{
+			{
+				std::lock_guard<std::mutex> frameLock(bufDescTable[frameNo].latch);
+				if (bufDescTable[frameNo].valid &&
+						bufDescTable[frameNo].file->fileId() == file->fileId() &&
+						bufDescTable[frameNo].pageNo == pageNos[i])
+				{
+					bufDescTable[frameNo].pinCnt++;
+					bufDescTable[frameNo].refbit = true;
+					bufDescTable[frameNo].rereferenced = true;
+					pages[i] = &bufPool[frameNo];
+					pinnedFrames.push_back(frameNo);
+					hitCount++;
+					break;
+				}
+			}
+			// lost the race with an eviction; retry
+		}
+		if (pages[i] == NULL)
+			missing.push_back(i);
+	}
+
+	// pass 2: fault the misses in together under one latch acquisition
+	std::vector<std::pair<std::size_t, FrameId> > loads;
+	if (!missing.empty())
+	{
+		const std::chrono::steady_clock::time_point missStart =
+				std::chrono::steady_clock::now();
+		std::lock_guard<std::mutex> allocLock(allocLatch);
+
+		std::map<PageId, FrameId> batchFrames; // dedupes repeats in the batch
+		std::vector<std::size_t> aliases;      // resolved once the loads land
+		std::size_t published = 0;
+		std::size_t engineReads = 0;           // loads not served by the victim cache
+
+		try
+		{
+			for (std::size_t m = 0; m < missing.size(); m++)
+			{
+				const std::size_t i = missing[m];
+				FrameId frameNo;
+
+				// another thread may have brought the page in while we probed;
+				// no eviction can run while we hold the allocation latch, so a
+				// plain pin suffices here
+				if (hashTable->tryLookup(file, pageNos[i], frameNo))
+				{
+					bufDescTable[frameNo].pinCnt++;
+					bufDescTable[frameNo].refbit = true;
+					bufDescTable[frameNo].rereferenced = true;
+					pages[i] = &bufPool[frameNo];
+					pinnedFrames.push_back(frameNo);
+					hitCount++;
+					continue;
+				}
+				if (batchFrames.count(pageNos[i]))
+				{
+					aliases.push_back(i);
+					continue;
+				}
+				allocBuf(frameNo, homePartition(file, pageNos[i]));
+				// claim the frame: it stays invalid until the batch publishes,
+				// and an unclaimed invalid frame is fair game for the next
+				// allocBuf call of this very loop
+				bufDescTable[frameNo].pinCnt = 1;
+				loads.push_back(std::make_pair(i, frameNo));
+				batchFrames[pageNos[i]] = frameNo;
+			}
+
+			// issue every read, then wait for all of them: the engine's
+			// workers overlap the I/O, and nothing may unwind while a read
+			// could still write into one of our frames
+			std::vector<std::future<void> > inFlight;
+			inFlight.reserve(loads.size());
+			for (std::size_t l = 0; l < loads.size(); l++)
+			{
+				// recently evicted pages come out of the victim cache at
+				// decompression cost; only the rest go to the engine
+				if (victimCache.get(file->fileId(), pageNos[loads[l].first],
+						bufPool[loads[l].second]))
+					continue;
+				engineReads++;
+				inFlight.push_back(file->readPageAsync(
+						pageNos[loads[l].first], bufPool[loads[l].second]));
+			}
+			std::exception_ptr firstError;
+			for (std::size_t l = 0; l < inFlight.size(); l++)
+			{
+				try
+				{
+					inFlight[l].get();
+				}
+				catch (...)
+				{
+					if (!firstError)
+					{
+						firstError = std::current_exception();
+					}
+				}
+			}
+			if (firstError)
+			{
+				std::rethrow_exception(firstError);
+			}
+
+			for (std::size_t l = 0; l < loads.size(); l++)
+			{
+				const std::size_t i = loads[l].first;
+				const FrameId frameNo = loads[l].second;
+				hashTable->insert(file, pageNos[i], frameNo);
+				bufDescTable[frameNo].Set(file, pageNos[i]);
+				publishFrame(frameNo);
+				fileIndexAdd(file, frameNo);
+				policyPagedIn(frameNo);
+				pages[i] = &bufPool[frameNo];
+				pinnedFrames.push_back(frameNo);
+				published++;
+			}
+
+			for (std::size_t a = 0; a < aliases.size(); a++)
+			{
+				const std::size_t i = aliases[a];
+				const FrameId frameNo = batchFrames[pageNos[i]];
+				bufDescTable[frameNo].pinCnt++;
+				bufDescTable[frameNo].refbit = true;
+				pages[i] = &bufPool[frameNo];
+				pinnedFrames.push_back(frameNo);
+				hitCount++; // served from the batch's own load, not its own read
+			}
+		}
+		catch (...)
+		{
+			// hand unpublished frames back to the free list, release every
+			// pin the batch holds, and let the error surface
+			for (std::size_t l = published; l < loads.size(); l++)
+			{
+				bufDescTable[loads[l].second].pinCnt = 0; // drop the claim
+				policyRemoved(loads[l].second);
+			}
+			for (std::size_t p = 0; p < pinnedFrames.size(); p++)
+			{
+				bufDescTable[pinnedFrames[p]].pinCnt--;
+			}
+			throw;
+		}
+
+		stats.misses.fetch_add(loads.size(), std::memory_order_relaxed);
+		stats.diskreads.fetch_add(engineReads, std::memory_order_relaxed);
+		const std::uint64_t micros =
+				std::chrono::duration_cast<std::chrono::microseconds>(
+						std::chrono::steady_clock::now() - missStart).count();
+		stats.missLatency[latencyBucket(micros)].fetch_add(
+				1, std::memory_order_relaxed);
+	}
+
+	stats.accesses.fetch_add(count, std::memory_order_relaxed);
+	stats.hits.fetch_add(hitCount, std::memory_order_relaxed);
+}
+
+/**
+ * Queues pages [first, first+count) of the file for asynchronous readahead.
+ * The prefetch thread is started lazily on the first request. Each prefetched
+ * page is faulted into a frame unpinned, so a later readPage call for it
+ * turns a blocking miss into a buffer hit.
+ * @param file the File instance whose pages to prefetch
+ * @param first the first page number to prefetch
+ * @param count the number of consecutive pages to prefetch
+ * @return void
+ */
+void BufMgr::prefetchPages(File* file, const PageId first, const std::uint32_t count)
+{
+	if (count == 0) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(prefetchMutex);
+	if (!prefetchRunning) {
+		prefetchRunning = true;
+		prefetchThread = std::thread(&BufMgr::prefetchMain, this);
+	}
+	prefetchQueue.push_back({file, first, count});
+	prefetchCv.notify_one();
+}
+
+/**
+ * Stops and joins the prefetch thread if running; queued requests are dropped.
+ * @param none
+ * @return void
+ */
+void BufMgr::stopPrefetcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(prefetchMutex);
+		if (!prefetchRunning) {
+			return;
+		}
+		prefetchRunning = false;
+		prefetchQueue.clear();
+		prefetchCv.notify_one();
+	}
+	prefetchThread.join();
+}
+
+/**
+ * Prefetch thread main loop. Services queued readahead requests by reading
+ * the pages into frames with pinCnt 0 and publishing them in the hash table.
+ * @param none
+ * @return void
+ */
+void BufMgr::prefetchMain()
+{
+	while (true)
+	{
+		PrefetchRequest request;
+		{
+			std::unique_lock<std::mutex> lock(prefetchMutex);
+			while (prefetchRunning && prefetchQueue.empty()) {
+				prefetchCv.wait(lock);
+			}
+			if (!prefetchRunning) {
+				return;
+			}
+			request = prefetchQueue.front();
+			prefetchQueue.pop_front();
+		}
+
+		for (std::uint32_t i = 0; i < request.count && prefetchRunning; i++)
+		{
+			const PageId pageNo = request.firstPage + i;
+			FrameId frameNo = 0;
+
+			if (hashTable->tryLookup(request.file, pageNo, frameNo)) {
+				continue; // already resident
+			}
+
+			std::lock_guard<std::mutex> allocLock(allocLatch);
+			if (hashTable->tryLookup(request.file, pageNo, frameNo)) {
+				continue;
+			}
+
+			try {
+				allocBuf(frameNo, homePartition(request.file, pageNo));
+				request.file->readPage(pageNo, bufPool[frameNo]);
+				hashTable->insert(request.file, pageNo, frameNo);
+				bufDescTable[frameNo].Set(request.file, pageNo);
+				publishFrame(frameNo);
+				fileIndexAdd(request.file, frameNo);
+				policyPagedIn(frameNo);
+				bufDescTable[frameNo].pinCnt = 0; // resident but not pinned
+			} catch (BufferExceededException &) {
+				break; // no evictable frames; abandon the rest of the request
+			} catch (InvalidPageException &) {
+				break; // ran past the end of the file
+			}
+		}
+	}
+}
+
+/**
+ * Decrements the pinCnt of the frame containing (file, PageNo) and,
+ if dirty == true, sets the dirty bit. 
+ Throws PAGENOTPINNED if the pin count is already 0. 
+ Does nothing if page is not found in the hash table lookup.
+ * @param file the File instance ocntaining the page to unpin
+ * @param pageNo the page number of the page to unpin
+ * @param dirty the bit representing whether the page was modified
+ * @return void
+ * @throws PageNotPinnedException, if the pin count of a page is already 0
+ */
+void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
+{
+	FrameId frameNo;
+
+	// page not resident; nothing to unpin
+	if (!hashTable->tryLookup(file, pageNo, frameNo))
+		return;
+
+	std::lock_guard<std::mutex> frameLock(bufDescTable[frameNo].latch);
+
+	// frame may have been evicted and reused since the lookup; file
+	// identity is by interned id since File objects may alias one file
+	if (!bufDescTable[frameNo].valid ||
+			bufDescTable[frameNo].file->fileId() != file->fileId() ||
+			bufDescTable[frameNo].pageNo != pageNo)
+	{
+		return;
+	}
+
+	if (dirty)
+	{ // If dirty == true, sets the dirty bit
+		bufDescTable[frameNo].dirty = true;
+		markFrameDirty(frameNo, true);
+	}
+
+	if (bufDescTable[frameNo].pinCnt == 0)
+	{ // Pincount is already 0
+		throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+	}
+
+	bufDescTable[frameNo].pinCnt--; // Decrements the pincount
+}
+
+/**
+ * Unpins a batch of pages of one file, in order. The per-page hash probe
+ * is inherent (each page may sit in any frame), so this is the batching
+ * counterpart of readPages for symmetry and call overhead only.
+ * @param file the File object instance the pages belong to
+ * @param pageNos the page numbers to unpin
+ * @param count the number of pages in the batch
+ * @param dirty true if the pages need to be marked dirty
+ * @return void
+ * @throws PageNotPinnedException, if one of the pages is not pinned
+ */
+void BufMgr::unPinPages(File* file, const PageId* pageNos,
+		const std::size_t count, const bool dirty)
+{
+	for (std::size_t i = 0; i < count; i++)
+	{
+		unPinPage(file, pageNos[i], dirty);
+	}
+}
+
+/**
+ * The first step in this method is to to allocate an empty page in the specified file by invoking
+	the file->allocatePage() method. This method will return a newly allocated page.
+	Then allocBuf() is called to obtain a buffer pool frame. Next, an entry is inserted into the
+	hash table and Set() is invoked on the frame to set it up properly. The method returns
+	both the page number of the newly allocated page to the caller via the pageNo parameter
+	and a pointer to the buffer frame allocated for the page via the page parameter.
+ * @param file the File instance representing the file where where the page will be allocated
+ * @param pageNo the page number of the newly allocated page
+ * @param page pointer to the newly allocated page
+ * @return page number of the newly allocated page, pointer to buffer frame for newly allocated page
+ */
+void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+{
+	allocPageInternal(file, pageNo, page, NO_PARTITION);
+}
+
+/**
+ * As allocPage(File*, PageId&, Page*&), but the new page's frame is taken
+ * from the named partition. Unknown names fall back to the page's default
+ * placement.
+ * @param file the file to allocate in
+ * @param pageNo the page number of the newly allocated page
+ * @param page pointer to the newly allocated page
+ * @param partition name of the partition to place the page in
+ * @return void
+ */
+void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page,
+		const std::string& partition)
+{
+	std::unordered_map<std::string, std::uint32_t>::const_iterator it =
+			partitionNames.find(partition);
+	allocPageInternal(file, pageNo, page,
+			it != partitionNames.end() ? it->second : NO_PARTITION);
+}
+
+/**
+ * As allocPage(File*, PageId&, Page*&), but returns an RAII handle for the
+ * pin so release needs no hash table lookup.
+ * @param file the file to allocate in
+ * @param pageNo reference through which the new page number is returned
+ * @return handle owning one pin on the new page
+ */
+PageHandle BufMgr::allocPage(File* file, PageId &pageNo)
+{
+	Page* page = NULL;
+	const FrameId frameNo = allocPageInternal(file, pageNo, page, NO_PARTITION);
+	return PageHandle(this, frameNo, page);
+}
+
+/**
+ * Shared body of the allocPage overloads; allocates and pins the page and
+ * reports the frame holding it.
+ * @param file the file to allocate in
+ * @param pageNo reference through which the new page number is returned
+ * @param page reference through which the pinned page is returned
+ * @return the frame holding the new page
+ */
+FrameId BufMgr::allocPageInternal(File* file, PageId &pageNo, Page*& page,
+		const std::uint32_t partition)
+{
+	FrameId frameNo = 0;
+
+	// allocation mutates both the file and the pool structure
+	std::lock_guard<std::mutex> allocLock(allocLatch);
+
+	// alloc empty page in the specified file
+	Page newPage = file->allocatePage();
+
+	// call allocBuf() to obtain buffer pool frame; the page number is only
+	// known after allocatePage, so the default placement resolves here
+	allocBuf(frameNo, partition != NO_PARTITION ? partition
+			: homePartition(file, newPage.page_number()));
+
+	// after bufPool frame obtained, set page to bufPool frame from allocBuf
+	bufPool[frameNo] = newPage;
+
+	// insert into hashtable
+	hashTable->insert(file, newPage.page_number(), frameNo);
+
+	// call Set() to set frame properly
+	bufDescTable[frameNo].Set(file, newPage.page_number());
+	publishFrame(frameNo);
+	fileIndexAdd(file, frameNo);
+	policyPagedIn(frameNo);
+
+	pageNo = newPage.page_number();
+	page = &bufPool[frameNo];
+
+	StatsShard& stats = statsShard();
+	stats.accesses.fetch_add(1, std::memory_order_relaxed);
+	stats.diskreads.fetch_add(1, std::memory_order_relaxed);
+	return frameNo;
+}
+
+/**
+ * Drops one pin on an already-identified frame; the PageHandle release
+ * path, which skips the hash table probe unPinPage does.
+ * @param frame the frame to unpin
+ * @param dirty true if the page needs to be marked dirty
+ * @return void
+ * @throws PageNotPinnedException, if the frame's pin count is already 0
+ */
+void BufMgr::unpinFrame(const FrameId frame, const bool dirty)
+{
+	std::lock_guard<std::mutex> frameLock(bufDescTable[frame].latch);
+
+	if (dirty)
+	{ // If dirty == true, sets the dirty bit
+		bufDescTable[frame].dirty = true;
+		markFrameDirty(frame, true);
+	}
+
+	if (bufDescTable[frame].pinCnt == 0)
+	{ // Pincount is already 0
+		throw PageNotPinnedException(bufDescTable[frame].file->filename(),
+				bufDescTable[frame].pageNo, frame);
+	}
+
+	bufDescTable[frame].pinCnt--; // Decrements the pincount
+}
+
+/**
+ * Returns the calling thread's counter shard; threads hash onto shards by
+ * thread id so hot-path increments stay on private cache lines.
+ * @return the shard
+ */
+BufMgr::StatsShard& BufMgr::statsShard()
+{
+	const std::size_t h = std::hash<std::thread::id>()(std::this_thread::get_id());
+	return statsShards[h & (NUM_STAT_SHARDS - 1)];
+}
+
+/**
+ * Maps a miss service time to its power-of-two histogram bucket.
+ * @param micros service time in microseconds
+ * @return the bucket index
+ */
+int BufMgr::latencyBucket(std::uint64_t micros)
+{
+	int bucket = 0;
+	while (micros > 1 && bucket < BufStats::LATENCY_BUCKETS - 1)
+	{
+		micros >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+/**
+ * Aggregates the counter shards into a consistent-enough snapshot.
+ * @return the aggregated statistics
+ */
+BufStats & BufMgr::getBufStats()
+{
+	bufStats.clear();
+	for (int s = 0; s < NUM_STAT_SHARDS; s++)
+	{
+		const StatsShard& shard = statsShards[s];
+		bufStats.accesses += shard.accesses.load(std::memory_order_relaxed);
+		bufStats.hits += shard.hits.load(std::memory_order_relaxed);
+		bufStats.misses += shard.misses.load(std::memory_order_relaxed);
+		bufStats.diskreads += shard.diskreads.load(std::memory_order_relaxed);
+		bufStats.diskwrites += shard.diskwrites.load(std::memory_order_relaxed);
+		bufStats.evictions += shard.evictions.load(std::memory_order_relaxed);
+		bufStats.evictionsClean +=
+				shard.evictionsClean.load(std::memory_order_relaxed);
+		bufStats.evictionsDirty +=
+				shard.evictionsDirty.load(std::memory_order_relaxed);
+		bufStats.victimSearches +=
+				shard.victimSearches.load(std::memory_order_relaxed);
+		bufStats.framesInspected +=
+				shard.framesInspected.load(std::memory_order_relaxed);
+		bufStats.pinSkips += shard.pinSkips.load(std::memory_order_relaxed);
+		bufStats.allocFailures +=
+				shard.allocFailures.load(std::memory_order_relaxed);
+		bufStats.victimSearchCycles +=
+				shard.victimSearchCycles.load(std::memory_order_relaxed);
+		for (int b = 0; b < BufStats::LATENCY_BUCKETS; b++)
+		{
+			bufStats.missLatency[b] +=
+					shard.missLatency[b].load(std::memory_order_relaxed);
+		}
+		for (int b = 0; b < BufStats::SWEEP_BUCKETS; b++)
+		{
+			bufStats.sweepLength[b] +=
+					shard.sweepLength[b].load(std::memory_order_relaxed);
+		}
+	}
+	return bufStats;
+}
+
+/**
+ * Resets every counter shard.
+ * @return void
+ */
+void BufMgr::clearBufStats()
+{
+	for (int s = 0; s < NUM_STAT_SHARDS; s++)
+	{
+		StatsShard& shard = statsShards[s];
+		shard.accesses.store(0, std::memory_order_relaxed);
+		shard.hits.store(0, std::memory_order_relaxed);
+		shard.misses.store(0, std::memory_order_relaxed);
+		shard.diskreads.store(0, std::memory_order_relaxed);
+		shard.diskwrites.store(0, std::memory_order_relaxed);
+		shard.evictions.store(0, std::memory_order_relaxed);
+		shard.evictionsClean.store(0, std::memory_order_relaxed);
+		shard.evictionsDirty.store(0, std::memory_order_relaxed);
+		shard.victimSearches.store(0, std::memory_order_relaxed);
+		shard.framesInspected.store(0, std::memory_order_relaxed);
+		shard.pinSkips.store(0, std::memory_order_relaxed);
+		shard.allocFailures.store(0, std::memory_order_relaxed);
+		shard.victimSearchCycles.store(0, std::memory_order_relaxed);
+		for (int b = 0; b < BufStats::LATENCY_BUCKETS; b++)
+		{
+			shard.missLatency[b].store(0, std::memory_order_relaxed);
+		}
+		for (int b = 0; b < BufStats::SWEEP_BUCKETS; b++)
+		{
+			shard.sweepLength[b].store(0, std::memory_order_relaxed);
+		}
+	}
+	bufStats.clear();
+}
+
+BulkScan::BulkScan(File* fileIn, const std::uint32_t ringFramesIn)
+	: file(fileIn), ringFrames(ringFramesIn),
+		pending(ringFramesIn), slotBusy(ringFramesIn, false),
+		nextToIssue(1), cursor(0), deliveredSlot(NO_SLOT) {
+	ring = new Page[ringFrames];
+	// valid page numbers run from 1 to num_pages - 1
+	lastPage = file->readHeader().num_pages - 1;
+	for (std::uint32_t slot = 0; slot < ringFrames; slot++)
+	{
+		issueNext(slot);
+	}
+}
+
+BulkScan::~BulkScan()
+{
+	// drain in-flight reads so the engine stops touching the ring
+	for (std::uint32_t slot = 0; slot < ringFrames; slot++)
+	{
+		if (slotBusy[slot])
+		{
+			try {
+				pending[slot].get();
+			} catch (InvalidPageException &) {
+				// free page; nothing to do
+			}
+		}
+	}
+	delete [] ring;
+}
+
+/**
+ * Issues asynchronous readahead for the next unread page into a slot.
+ * @param slot the ring slot to read into
+ * @return void
+ */
+void BulkScan::issueNext(const std::uint32_t slot)
+{
+	if (nextToIssue > lastPage)
+	{
+		return;
+	}
+	pending[slot] = file->readPageAsync(nextToIssue, ring[slot]);
+	nextToIssue++;
+	slotBusy[slot] = true;
+}
+
+/**
+ * Returns the next used page of the file in physical order, or NULL when
+ * the scan is complete.
+ * @return pointer into the ring, valid until the following next() call
+ */
+const Page* BulkScan::next()
+{
+	// the slot handed out last time is free again; refill it
+	if (deliveredSlot != NO_SLOT)
+	{
+		issueNext(deliveredSlot);
+		deliveredSlot = NO_SLOT;
+	}
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
-	bufDescTable = new BufDesc[bufs];
+	while (true)
+	{
+		const std::uint32_t slot = cursor;
+		if (!slotBusy[slot])
+		{
+			return NULL; // ring drained: end of file
+		}
+		cursor = (cursor + 1) % ringFrames;
+		slotBusy[slot] = false;
 
-  for (FrameId i = 0; i < bufs; i++) 
-  {
-  	bufDescTable[i].frameNo = i;
-  	bufDescTable[i].valid = false;
-  }
+		try {
+			pending[slot].get();
+		} catch (InvalidPageException &) {
+			// free page on disk; skip it and keep the ring full
+			issueNext(slot);
+			continue;
+		}
 
-  bufPool = new Page[bufs];
+		deliveredSlot = slot;
+		return &ring[slot];
+	}
+}
 
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+PageHandle::PageHandle()
+	: bufMgr(NULL), frame(0), pagePtr(NULL) {
+}
 
-  clockHand = bufs - 1;
+PageHandle::PageHandle(BufMgr* bufMgrIn, const FrameId frameIn, Page* pageIn)
+	: bufMgr(bufMgrIn), frame(frameIn), pagePtr(pageIn) {
 }
 
-/**
- * Flushes out all dirty pages and deallocates the buffer pool and the BufDesc table.
- * @param none
- * @return void
- */
-BufMgr::~BufMgr() {
-	for (FrameId i = 0; i < numBufs; i++) {
-		if(bufDescTable[i].dirty == true) { // If dirtybit == true, flush the page
-			flushFile(bufDescTable[i].file);
+PageHandle::PageHandle(PageHandle&& other)
+	: bufMgr(other.bufMgr), frame(other.frame), pagePtr(other.pagePtr) {
+	other.pagePtr = NULL;
+}
+
+PageHandle& PageHandle::operator=(PageHandle&& other)
+{
+	if (this != &other)
+	{
+		if (pagePtr != NULL && bufMgr != NULL)
+		{
+			bufMgr->unpinFrame(frame, false);
 		}
+		bufMgr = other.bufMgr;
+		frame = other.frame;
+		pagePtr = other.pagePtr;
+		other.pagePtr = NULL;
+	}
+	return *this;
+}
+
+PageHandle::~PageHandle()
+{
+	if (pagePtr != NULL && bufMgr != NULL)
+	{
+		bufMgr->unpinFrame(frame, false);
 	}
-	delete [] bufDescTable; // Deallocation
-	delete [] bufPool;
-	delete hashTable;
 }
 
 /**
- * Advances clock to the next frame in the buffer pool.
- * @param none
+ * Releases the pin by decrementing the frame's pin count directly.
+ * @param dirty true if the page needs to be marked dirty
  * @return void
+ * @throws PageNotPinnedException, if the frame's pin count is already 0
  */
-void BufMgr::advanceClock()
+void PageHandle::unpin(const bool dirty)
 {
-	if(this->clockHand == this->numBufs - 1) {
-		this->clockHand = 0;
+	if (pagePtr == NULL)
+	{
+		return;
 	}
-	else {
-		this->clockHand++;
+	pagePtr = NULL;
+	if (bufMgr != NULL)
+	{
+		bufMgr->unpinFrame(frame, dirty);
 	}
 }
 
 /**
- * Allocates a free frame using the clock algorithm; if necessary, writing a dirty page back
-	to disk. Throws BufferExceededException if all buffer frames are pinned. This private
-	method will get called by the readPage() and allocPage() methods described below. Make
-	sure that if the buffer frame allocated has a valid page in it, you remove the appropriate
-	entry from the hash table.
- * @param frame pointer to newly allocated frame
- * @return pointer to the newly allocated frame
- * @throws BufferExceededException, if all buffer frames are pinned
+ * Should scan bufTable for pages belonging to the file. For each page encountered it should:
+	(a) if the page is dirty, call file->writePage() to flush the page to disk and then set the dirty bit for the page to false, (b) remove the page from the hashtable (whether the page is clean or dirty) and (c) invoke the Clear() method of BufDesc for the page frame.
+	Throws PagePinnedException if some page of the file is pinned. Throws BadBuffer-
+	Exception if an invalid page belonging to the file is encountered.
+ * @param file the File object instance to flush 
+ * @return void
+ * @throws PagePinnedException, if a page of the file is pinned
+ * @throws BadBufferException, if an invalid page belonging to the file is encountered
  */
-void BufMgr::allocBuf(FrameId & frame) 
+void BufMgr::flushFile(const File* file) 
 {
-	std::uint32_t pincount = 0;
+	std::vector<FrameId> dirtyFrames;
 
-	while(pincount <= numBufs - 1) 
 	{
+		// serialize against frame allocation while we sweep the file's frames
+		std::lock_guard<std::mutex> allocLock(allocLatch);
 
-		this->advanceClock(); //Advance Clock Pointer
-		frame = clockHand; // set frame to current clockhand
+		// the per-file index lists exactly the frames owned by this file, so a
+		// small file's flush no longer walks the whole descriptor table
+		std::unordered_map<FileId, std::vector<FrameId> >::iterator it =
+				fileFrames.find(file->fileId());
+		if (it == fileFrames.end()) {
+			return;
+		}
+		const std::vector<FrameId>& frames = it->second;
 
-		if (bufDescTable[frame].valid == false) 
+		// validate the file's frames and collect the dirty ones
+		for(std::size_t f = 0; f < frames.size(); f++)
 		{
-			return;
-		} else {
+			const FrameId i = frames[f];
+			std::lock_guard<std::mutex> frameLock(bufDescTable[i].latch);
 
-			if (bufDescTable[frame].refbit == true) 
-			{ //Checks if refbit has been set
-				bufDescTable[frame].refbit = false;
-				continue;
-			} else {
+			//page belongs to file but it is not valid, throw exception
+			if(bufDescTable[i].valid == false)
+			{
+				throw BadBufferException(bufDescTable[i].frameNo, bufDescTable[i].dirty, bufDescTable[i].valid, bufDescTable[i].refbit);
+			}
 
-				if(bufDescTable[frame].pinCnt > 0) 
-				{ //Checks if Page has been pinned
-					pincount++;
-					continue;
-				}
-				else if(bufDescTable[frame].dirty == true) 
-				{ //Checks Dirty Bit
-					bufDescTable[frame].dirty = false;
-					// write page back to disk
-					bufDescTable[frame].file->writePage(bufPool[frame]);
-				}
-				try{ //remove entry from hashtable
-					hashTable->remove(bufDescTable[frame].file, bufDescTable[frame].pageNo);
-				} catch(HashNotFoundException e){
+			// if page of file is pinned, throw exception
+			if(bufDescTable[i].pinCnt != 0)
+			{
+				throw PagePinnedException(bufDescTable[i].file->filename(), bufDescTable[i].pageNo, bufDescTable[i].frameNo);
+			}
 
-				}
-				return;
+			if(bufDescTable[i].dirty)
+			{
+				dirtyFrames.push_back(i);
 			}
 		}
-	}
 
-	if(pincount > numBufs - 1) 
-	{ // exceeds buffer size or frames are all pinned
-		throw BufferExceededException();
+		// pin the dirty frames so they cannot be chosen as victims while we
+		// write them back without holding the allocation latch
+		for(std::size_t f = 0; f < dirtyFrames.size(); f++)
+		{
+			bufDescTable[dirtyFrames[f]].pinCnt++;
+		}
 	}
 
-	bufDescTable[frame].Clear();
-
-	// return pointer to newly alloc buffer frame via frame param
-	frame = bufDescTable[clockHand].frameNo;
-}
+	// write back outside the allocation latch so concurrent flushes of
+	// other files (flushAll) overlap their I/O; in page-number order,
+	// coalescing runs of adjacent pages into single vectored writes so a
+	// checkpoint streams sequentially instead of seeking once per frame
+	try
+	{
+		std::sort(dirtyFrames.begin(), dirtyFrames.end(),
+				[this](const FrameId a, const FrameId b) {
+					return bufDescTable[a].pageNo < bufDescTable[b].pageNo;
+				});
+		std::vector<const Page*> run;
+		PageId runNext = Page::INVALID_NUMBER;
+		for(std::size_t f = 0; f < dirtyFrames.size(); f++)
+		{
+			const FrameId i = dirtyFrames[f];
+			if(!run.empty() && bufDescTable[i].pageNo != runNext)
+			{
+				bufDescTable[dirtyFrames[f - 1]].file->writePages(run);
+				statsShard().diskwrites.fetch_add(run.size(), std::memory_order_relaxed);
+				run.clear();
+			}
+			run.push_back(&bufPool[i]);
+			runNext = bufDescTable[i].pageNo + 1;
+			bufDescTable[i].dirty = false;
+			markFrameDirty(i, false);
+		}
+		if(!run.empty())
+		{
+			bufDescTable[dirtyFrames.back()].file->writePages(run);
+			statsShard().diskwrites.fetch_add(run.size(), std::memory_order_relaxed);
+		}
+	}
+	catch (...)
+	{
+		for(std::size_t f = 0; f < dirtyFrames.size(); f++)
+		{
+			bufDescTable[dirtyFrames[f]].pinCnt--;
+		}
+		throw;
+	}
 
-/**
- * First check whether the page is already in the buffer pool by invoking the lookup() method,
-	which may throw HashNotFoundException when page is not in the buffer pool, on the
-	hashtable to get a frame number. There are two cases to be handled depending on the
-	outcome of the lookup() call:
- 		Case 1: Page is not in the buffer pool. Call allocBuf() to allocate a buffer frame and
-			then call the method file->readPage() to read the page from disk into the buffer pool
-			frame. Next, insert the page into the hashtable. Finally, invoke Set() on the frame to
-			set it up properly. Set() will leave the pinCnt for the page set to 1. Return a pointer
-			to the frame containing the page via the page parameter.
- 		Case 2: Page is in the buffer pool. In this case set the appropriate refbit, increment
-			the pinCnt for the page, and then return a pointer to the frame containing the page
-			via the page parameter.
- * @param file the File instance to contain the page to read
- * @param pageNo the page number of the page to read
- * @param page pointer to the frame containing the newly read page
- * @return pointer to the frame containing the page
- */
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
-{
-	FrameId frameNo = 0; // to hold the frame num returned by lookup()
+	{
+		std::lock_guard<std::mutex> allocLock(allocLatch);
 
-	try {
+		for(std::size_t f = 0; f < dirtyFrames.size(); f++)
+		{
+			bufDescTable[dirtyFrames[f]].pinCnt--;
+		}
 
-		hashTable->lookup(file, pageNo, frameNo);
-		bufDescTable[frameNo].refbit = true; // set reference bit to true
-		bufDescTable[frameNo].pinCnt++; // increment pin count
-		page = &bufPool[frameNo]; //return pointer to frame containing page
+		// re-fetch the index: frames faulted in by other threads while we
+		// were writing belong to the file too and must be dropped as well
+		std::unordered_map<FileId, std::vector<FrameId> >::iterator it =
+				fileFrames.find(file->fileId());
+		if (it == fileFrames.end()) {
+			return;
+		}
+		std::vector<FrameId> frames = it->second; // copy; cleared as we go
 
-	} catch (HashNotFoundException noHash) {
+		for(std::size_t f = 0; f < frames.size(); f++)
+		{
+			const FrameId i = frames[f];
+			std::lock_guard<std::mutex> frameLock(bufDescTable[i].latch);
 
-		try {
+			// a page faulted in and pinned during the writeback phase breaks
+			// the flush contract the same way it does up front
+			if(bufDescTable[i].pinCnt != 0)
+			{
+				throw PagePinnedException(bufDescTable[i].file->filename(), bufDescTable[i].pageNo, bufDescTable[i].frameNo);
+			}
 
-			allocBuf(frameNo); // alloc a buffer frame for page
-			bufPool[frameNo] = file->readPage(pageNo); // read page into buffer
-			hashTable->insert(file, pageNo, frameNo); // update hashtable
-			bufDescTable[frameNo].Set(file, pageNo); // set up frame properly
-			page = &bufPool[frameNo];
+			// a frame redirtied (or faulted in dirty) during the unlatched
+			// writeback window still holds a committed update; write it back
+			// before discarding the frame
+			if(bufDescTable[i].dirty)
+			{
+				bufDescTable[i].dirty = false;
+				markFrameDirty(i, false);
+				bufDescTable[i].file->writePage(bufPool[i]);
+				statsShard().diskwrites.fetch_add(1, std::memory_order_relaxed);
+			}
 
-		} catch(BufferExceededException) {
-			// do nothing for exceptions
-		}		
-	} catch(...) {
-		// Dont do anything
+			// remove page from hashtable
+			hashTable->remove(file, bufDescTable[i].pageNo);
+			// invoke clear() method for page frame
+			bufDescTable[i].Clear();
+			unpublishFrame(i);
+			fileIndexRemove(file, i);
+			policyRemoved(i);
+		}
 	}
 }
 
 /**
- * Decrements the pinCnt of the frame containing (file, PageNo) and, 
- if dirty == true, sets the dirty bit. 
- Throws PAGENOTPINNED if the pin count is already 0. 
- Does nothing if page is not found in the hash table lookup.
- * @param file the File instance ocntaining the page to unpin
- * @param pageNo the page number of the page to unpin
- * @param dirty the bit representing whether the page was modified
+ * Flushes every file in <files> using the shared I/O engine's worker
+ * pool, so the writeback phases of the individual flushes overlap and a
+ * checkpoint keeps several write streams in flight. Every flush runs to
+ * completion before this returns; the first exception raised by any of
+ * them is rethrown afterwards.
+ * @param files the File object instances to flush
  * @return void
- * @throws PageNotPinnedException, if the pin count of a page is already 0
+ * @throws PagePinnedException, if a page of a file is pinned
+ * @throws BadBufferException, if an invalid page belonging to a file is encountered
  */
-void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
+void BufMgr::flushAll(const std::vector<File*>& files)
 {
-	FrameId frameNo;
-	try{
-
-		hashTable->lookup(file, pageNo, frameNo); // look up page
+	std::vector<std::future<void> > pending;
+	pending.reserve(files.size());
+	for(std::size_t f = 0; f < files.size(); f++)
+	{
+		File* file = files[f];
+		pending.push_back(IoEngine::instance().submit(
+				[this, file]() { flushFile(file); }));
+	}
 
-		if (dirty) 
-		{ // If dirty == true, sets the dirty bit
-			bufDescTable[frameNo].dirty = true;
+	std::exception_ptr firstError;
+	for(std::size_t f = 0; f < pending.size(); f++)
+	{
+		try
+		{
+			pending[f].get();
 		}
-
-		if (bufDescTable[frameNo].pinCnt == 0) 
-		{ // Pincount is already 0
-			throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+		catch (...)
+		{
+			if (!firstError)
+			{
+				firstError = std::current_exception();
+			}
 		}
-
-		bufDescTable[frameNo].pinCnt--; // Decrements the pincount
-
 	}
-	catch (HashNotFoundException &e) {
-		// Do nothing for exceptions
+	if (firstError)
+	{
+		std::rethrow_exception(firstError);
 	}
-	
 }
 
 /**
- * The first step in this method is to to allocate an empty page in the specified file by invoking
-	the file->allocatePage() method. This method will return a newly allocated page.
-	Then allocBuf() is called to obtain a buffer pool frame. Next, an entry is inserted into the
-	hash table and Set() is invoked on the frame to set it up properly. The method returns
-	both the page number of the newly allocated page to the caller via the pageNo parameter
-	and a pointer to the buffer frame allocated for the page via the page parameter.
- * @param file the File instance representing the file where where the page will be allocated
- * @param pageNo the page number of the newly allocated page
- * @param page pointer to the newly allocated page
- * @return page number of the newly allocated page, pointer to buffer frame for newly allocated page
+ * As flushAll(files), but targets every file that currently owns a frame
+ * in the pool.
+ * @param none
+ * @return void
+ * @throws PagePinnedException, if a page of a file is pinned
+ * @throws BadBufferException, if an invalid page belonging to a file is encountered
  */
-void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+void BufMgr::flushAll()
 {
-	FrameId frameNo = 0;
-
-	// alloc empty page in the specified file 
-	Page newPage = file->allocatePage();
-	
-	// call allocBuf() to obtain buffer pool frame
-	allocBuf(frameNo);
-
-	// after bufPool frame obtained, set page to bufPool frame from allocBuf
-	bufPool[frameNo] = newPage;
-
-	// insert into hashtable
-	hashTable->insert(file, newPage.page_number(), frameNo);
-
-	// call Set() to set frame properly
-	bufDescTable[frameNo].Set(file, newPage.page_number());
-
-	pageNo = newPage.page_number();
-	page = &bufPool[frameNo];
-
+	std::vector<File*> files;
+	{
+		std::lock_guard<std::mutex> allocLock(allocLatch);
+		std::unordered_set<FileId> seen;
+		for (FrameId i = 0; i < numBufs; i++)
+		{
+			BufDesc* desc = &bufDescTable[i];
+			if (desc->valid && desc->file != NULL &&
+					seen.insert(desc->file->fileId()).second)
+			{
+				files.push_back(desc->file);
+			}
+		}
+	}
+	flushAll(files);
 }
 
 /**
- * Should scan bufTable for pages belonging to the file. For each page encountered it should:
-	(a) if the page is dirty, call file->writePage() to flush the page to disk and then set the dirty bit for the page to false, (b) remove the page from the hashtable (whether the page is clean or dirty) and (c) invoke the Clear() method of BufDesc for the page frame.
-	Throws PagePinnedException if some page of the file is pinned. Throws BadBuffer-
-	Exception if an invalid page belonging to the file is encountered.
- * @param file the File object instance to flush 
+ * Changes the number of frames in circulation. Shrinking drains the
+ * trimmed tail — dirty pages written back, resident pages evicted, the
+ * frames pulled off their free lists and queues — and then releases the
+ * memory behind them to the OS, so a nightly shrink actually lends the
+ * RAM out. Growing re-initializes the tail frames (the kernel hands the
+ * pages back zeroed) and restocks the free lists. Partition geometry is
+ * in terms of the construction-time capacity, so no surviving frame
+ * changes home. All-or-nothing on shrink: a pinned page in the trimmed
+ * range aborts before anything is evicted.
+ * @param newNumBufs the new number of frames, in [1, construction size]
  * @return void
- * @throws PagePinnedException, if a page of the file is pinned
- * @throws BadBufferException, if an invalid page belonging to the file is encountered
+ * @throws PagePinnedException, if a page in the trimmed range is pinned
+ * @throws BufferExceededException, if newNumBufs is 0 or exceeds capacity
  */
-void BufMgr::flushFile(const File* file) 
+void BufMgr::resize(const std::uint32_t newNumBufs)
 {
-	// scan/iterate through pages in bufTable belonging to file
-	for(std::uint32_t i = 0; i < numBufs; i++)
+	std::lock_guard<std::mutex> allocLock(allocLatch);
+
+	if (newNumBufs < 1 || newNumBufs > capacityBufs)
+	{
+		throw BufferExceededException();
+	}
+	if (newNumBufs == numBufs)
 	{
-		// page belongs to file and is valid
-		if(bufDescTable[i].file == file && bufDescTable[i].valid)
+		return;
+	}
+
+	if (newNumBufs < numBufs)
+	{
+		// abort before touching anything if the trim would hit a pin
+		for (FrameId i = newNumBufs; i < numBufs; i++)
 		{
-			// if page dity, call writePage() to flush to disk & set dirty bit to false
-			if(bufDescTable[i].dirty)
+			if (bufDescTable[i].valid && bufDescTable[i].pinCnt > 0)
 			{
-				bufDescTable[i].file->writePage(bufPool[bufDescTable[i].frameNo]);
-				bufDescTable[i].dirty = false;
+				throw PagePinnedException(bufDescTable[i].file->filename(),
+						bufDescTable[i].pageNo, i);
 			}
+		}
 
-			// if page of file is pinned, throw exception
-			if(bufDescTable[i].pinCnt != 0)
+		for (FrameId i = newNumBufs; i < numBufs; i++)
+		{
+			std::lock_guard<std::mutex> frameLock(bufDescTable[i].latch);
+			if (bufDescTable[i].valid)
 			{
-				throw PagePinnedException(bufDescTable[i].file->filename(), bufDescTable[i].pageNo, bufDescTable[i].frameNo);
+				if (bufDescTable[i].pinCnt > 0)
+				{ // pinned between the check above and here
+					throw PagePinnedException(bufDescTable[i].file->filename(),
+							bufDescTable[i].pageNo, i);
+				}
+				evictFrame(i); // writes back if dirty, drops the hash entry
+			}
+			if (policy == POLICY_TWO_Q)
+			{
+				listRemove(i);
 			}
-
-			// remove page from hashtable
-			hashTable->remove(file, bufDescTable[i].pageNo);
-			// invoke clear() method for page frame
 			bufDescTable[i].Clear();
+			unpublishFrame(i);
+		}
+
+		// drain the retired frames from the free lists
+		for (std::uint32_t p = 0; p < numPartitions; p++)
+		{
+			std::vector<FrameId>& list = freeFrames[p];
+			std::size_t kept = 0;
+			for (std::size_t f = 0; f < list.size(); f++)
+			{
+				if (list[f] < newNumBufs)
+				{
+					list[kept++] = list[f];
+				}
+			}
+			list.resize(kept);
 		}
 
-		//page belongs to file but it is not valid, throw exception
-		if(bufDescTable[i].file == file && bufDescTable[i].valid == false)
+		numBufs = newNumBufs;
+
+		// hand the memory behind the retired frames back to the OS; the
+		// first fault after a later grow rematerializes it zero-filled
+		const std::size_t osPage = (std::size_t)::sysconf(_SC_PAGESIZE);
+		std::size_t begin = (std::size_t)numBufs * sizeof(Page);
+		begin = (begin + osPage - 1) / osPage * osPage;
+		if (begin < bufPoolSlabBytes)
+		{
+			::madvise((char*)bufPool + begin, bufPoolSlabBytes - begin,
+					MADV_DONTNEED);
+		}
+	}
+	else
+	{
+		for (FrameId i = numBufs; i < newNumBufs; i++)
 		{
-			throw BadBufferException(bufDescTable[i].frameNo, bufDescTable[i].dirty, bufDescTable[i].valid, bufDescTable[i].refbit);
+			new (&bufPool[i]) Page();
+			bufDescTable[i].Clear();
+			bufDescTable[i].queue = QUEUE_NONE;
+			bufDescTable[i].prev = NO_FRAME;
+			bufDescTable[i].next = NO_FRAME;
+			freeFrames[partitionOfFrame(i)].push_back(i);
 		}
+		numBufs = newNumBufs;
 	}
 }
 
@@ -330,22 +2515,50 @@ void BufMgr::flushFile(const File* file)
 void BufMgr::disposePage(File* file, const PageId PageNo)
 {
 	FrameId frameNum;
-	try {
 
-		// make sure page to be deleted is allocated in buffer pool
-		hashTable->lookup(file, PageNo, frameNum);
+	std::lock_guard<std::mutex> allocLock(allocLatch);
+
+	// if the page to be deleted is allocated a frame in the buffer pool,
+	// free the frame and remove the corresponding hash table entry
+	if (hashTable->tryLookup(file, PageNo, frameNum))
+	{
+		std::lock_guard<std::mutex> frameLock(bufDescTable[frameNum].latch);
 		// clear entry from description table for the frame
 		bufDescTable[frameNum].Clear();
+		unpublishFrame(frameNum);
+		fileIndexRemove(file, frameNum);
+		policyRemoved(frameNum);
 		// remove correspoding entry from hashtable
 		hashTable->remove(file, PageNo);
-
-	} catch (HashNotFoundException e) {
-		// this means page to be removed was never alloc as a frame in buffer pool
 	}
+	victimCache.remove(file->fileId(), PageNo);
 	// delete page from file
 	file->deletePage(PageNo);
 }
 
+/**
+ * Sets the compressed victim cache capacity in bytes; 0 disables it.
+ * @param maxBytes capacity in bytes of compressed page data
+ * @return void
+ */
+void BufMgr::setVictimCacheBytes(const std::size_t maxBytes)
+{
+	victimCache.setCapacity(maxBytes);
+}
+
+/**
+ * Returns the victim cache counters.
+ * @param hits receives the hit count
+ * @param stores receives the store count
+ * @param evictions receives the recycle count
+ * @return void
+ */
+void BufMgr::getVictimCacheStats(std::uint64_t & hits, std::uint64_t & stores,
+		std::uint64_t & evictions)
+{
+	victimCache.getStats(hits, stores, evictions);
+}
+
 /**
  * Print member variable values. 
  * @param void 
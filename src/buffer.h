@@ -16,20 +16,46 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 #include "file.h"
 #include "bufHashTbl.h"
+#include "victimCache.h"
 
 namespace badgerdb {
 
 /**
-* forward declaration of BufMgr class 
+* forward declaration of BufMgr class
 */
 class BufMgr;
 
+/**
+* Replacement policy used by the buffer manager to pick eviction victims.
+*
+* POLICY_CLOCK is the classic single-refbit clock. POLICY_TWO_Q is a
+* scan-resistant two-queue policy: pages faulted in land in a FIFO probation
+* queue (A1) and are only promoted to the protected LRU queue (Am) if they
+* are referenced again while resident, so a one-pass scan cannot flush the
+* hot working set.
+*/
+enum ReplacementPolicy
+{
+	POLICY_CLOCK,
+	POLICY_TWO_Q
+};
+
 /**
 * @brief Class for maintaining information about buffer pool frames
 */
-class BufDesc {
+class alignas(64) BufDesc {
 
 	friend class BufMgr;
 
@@ -50,9 +76,10 @@ class BufDesc {
   FrameId	frameNo;
 
 	/**
-   * Number of times this page has been pinned
+   * Number of times this page has been pinned. Atomic so that concurrent
+   * readers can pin/unpin a hot frame without taking the frame latch.
 	 */
-  int pinCnt;
+  std::atomic<int> pinCnt;
 
 	/**
    * True if page is dirty;  false otherwise
@@ -65,9 +92,37 @@ class BufDesc {
   bool valid;
 
 	/**
-   * Has this buffer frame been reference recently
+   * Has this buffer frame been reference recently. Atomic so readers can set
+   * it without holding the frame latch.
+	 */
+  std::atomic<bool> refbit;
+
+	/**
+   * Per-frame latch protecting state transitions (eviction, Set/Clear) on
+   * this frame. Readers only take it briefly to validate a pin.
+	 */
+  std::mutex latch;
+
+	/**
+   * Set on every buffer hit while the page is resident; consumed by the
+   * 2Q policy at eviction time to decide promotion, so hits stay latch-free.
+	 */
+  std::atomic<bool> rereferenced;
+
+	/**
+   * Which 2Q queue this frame is linked into (QUEUE_NONE under clock)
+	 */
+  std::uint8_t queue;
+
+	/**
+   * Previous frame in this frame's 2Q queue, or NO_FRAME
+	 */
+  FrameId prev;
+
+	/**
+   * Next frame in this frame's 2Q queue, or NO_FRAME
 	 */
-  bool refbit;
+  FrameId next;
 
 	/**
    * Initialize buffer frame for a new user
@@ -83,9 +138,13 @@ class BufDesc {
   };
 
 	/**
-	 * Set values of member variables corresponding to assignment of frame to a page in the file. Called when a frame 
+	 * Set values of member variables corresponding to assignment of frame to a page in the file. Called when a frame
 	 * in buffer pool is allocated to any page in the file through readPage() or allocPage()
 	 *
+	 * The plain pinCnt store relies on the caller owning the frame
+	 * exclusively: readers only pin after re-validating under the frame
+	 * latch, and an evicted (invalid) frame never passes that check.
+	 *
 	 * @param filePtr	File object
 	 * @param pageNum	Page number in the file
 	 */
@@ -110,7 +169,7 @@ class BufDesc {
 			std::cout << "file:NULL ";
 
 		std::cout << "valid:" << valid << " ";
-		std::cout << "pinCnt:" << pinCnt << " ";
+		std::cout << "pinCnt:" << pinCnt.load() << " ";
 		std::cout << "dirty:" << dirty << " ";
 		std::cout << "refbit:" << refbit << "\n";
   }
@@ -130,27 +189,121 @@ class BufDesc {
 */
 struct BufStats
 {
+	/**
+   * Number of buckets in the miss-latency histogram; bucket i counts
+   * misses serviced in [2^i, 2^(i+1)) microseconds, with the last bucket
+   * absorbing everything slower
+	 */
+  static const int LATENCY_BUCKETS = 16;
+
+	/**
+   * Number of buckets in the sweep-length histogram; bucket i counts
+   * victim searches that inspected [2^i, 2^(i+1)) frames, with the last
+   * bucket absorbing everything longer
+	 */
+  static const int SWEEP_BUCKETS = 16;
+
 	/**
    * Total number of accesses to buffer pool
 	 */
-  int accesses;
+  std::uint64_t accesses;
+
+	/**
+   * Number of accesses served from a resident frame
+	 */
+  std::uint64_t hits;
+
+	/**
+   * Number of accesses that had to fault the page in
+	 */
+  std::uint64_t misses;
 
 	/**
    * Number of pages read from disk (including allocs)
 	 */
-  int diskreads;
+  std::uint64_t diskreads;
 
 	/**
    * Number of pages written back to disk
 	 */
-  int diskwrites;
+  std::uint64_t diskwrites;
+
+	/**
+   * Number of resident pages evicted to make room
+	 */
+  std::uint64_t evictions;
+
+	/**
+   * Evictions that needed no writeback
+	 */
+  std::uint64_t evictionsClean;
+
+	/**
+   * Evictions that had to write the page back first
+	 */
+  std::uint64_t evictionsDirty;
+
+	/**
+   * Number of victim searches run by allocBuf
+	 */
+  std::uint64_t victimSearches;
+
+	/**
+   * Frames inspected across all victim searches; divided by
+   * victimSearches this is the mean sweep length
+	 */
+  std::uint64_t framesInspected;
+
+	/**
+   * Frames skipped during victim searches because they were pinned; a
+   * high rate relative to framesInspected means pin starvation
+	 */
+  std::uint64_t pinSkips;
+
+	/**
+   * Victim searches that failed outright (BufferExceededException)
+	 */
+  std::uint64_t allocFailures;
+
+	/**
+   * Cycles spent in victim searches, measured with rdtsc. Only counted
+   * when built with -DBADGERDB_RDTSC (see RDTSC in the Makefile);
+   * otherwise stays 0.
+	 */
+  std::uint64_t victimSearchCycles;
+
+	/**
+   * Histogram of victim search sweep lengths (frames inspected per
+   * search), in power-of-two buckets
+	 */
+  std::uint64_t sweepLength[SWEEP_BUCKETS];
+
+	/**
+   * Histogram of readPage miss service times, in power-of-two
+   * microsecond buckets
+	 */
+  std::uint64_t missLatency[LATENCY_BUCKETS];
+
+	/**
+   * Fraction of accesses served without a fault, 0 if there were none
+	 */
+  double hitRatio() const
+  {
+		return accesses == 0 ? 0.0 : (double)hits / (double)accesses;
+  }
 
 	/**
    * Clear all values 
 	 */
   void clear()
   {
-		accesses = diskreads = diskwrites = 0;
+		accesses = hits = misses = diskreads = diskwrites = evictions = 0;
+		evictionsClean = evictionsDirty = victimSearches = 0;
+		framesInspected = pinSkips = allocFailures = victimSearchCycles = 0;
+		for (int i = 0; i < LATENCY_BUCKETS; i++)
+			missLatency[i] = 0;
+		for (int i = 0; i < SWEEP_BUCKETS; i++)
+			sweepLength[i] = 0;
   }
       
 	/**
@@ -163,6 +316,227 @@ struct BufStats
 };
 
 
+/**
+ * @brief Streams a file's pages through a small private ring of frames,
+ * bypassing the buffer pool entirely.
+ *
+ * Backups and full-file scans would otherwise wipe out the OLTP working
+ * set; a BulkScan never touches the hash table or the frame descriptors,
+ * so a multi-hundred-gigabyte pass leaves the pool untouched. Pages are
+ * delivered in physical (sequential disk) order with the ring depth worth
+ * of asynchronous readahead kept in flight on the I/O engine, and free
+ * pages are skipped. The pointer returned by next() stays valid until the
+ * following next() call.
+ */
+class BulkScan
+{
+ public:
+	/**
+   * Starts a scan over the file's pages.
+	 *
+	 * @param fileIn			File to scan
+	 * @param ringFramesIn	Number of private frames (and readahead depth)
+	 */
+  BulkScan(File* fileIn, const std::uint32_t ringFramesIn = 16);
+
+	/**
+   * Drains any in-flight readahead and releases the ring.
+	 */
+  ~BulkScan();
+
+	/**
+   * Returns the next used page of the file, or NULL when the scan is
+	 * complete. The returned page lives in the ring and is overwritten by
+	 * a later call.
+	 */
+  const Page* next();
+
+ private:
+	/**
+   * Sentinel for deliveredSlot when no page is currently handed out
+	 */
+  static const std::uint32_t NO_SLOT = 0xFFFFFFFF;
+
+	/**
+   * Issues the next unread page of the file into the given ring slot,
+	 * if any pages remain.
+	 *
+	 * @param slot	Ring slot to read into
+	 */
+  void issueNext(const std::uint32_t slot);
+
+	/**
+   * File being scanned
+	 */
+  File* file;
+
+	/**
+   * Number of frames in the ring
+	 */
+  std::uint32_t ringFrames;
+
+	/**
+   * The private frames pages stream through
+	 */
+  Page* ring;
+
+	/**
+   * Completion token of the read in flight for each slot
+	 */
+  std::vector<std::future<void> > pending;
+
+	/**
+   * Whether each slot has a read in flight
+	 */
+  std::vector<bool> slotBusy;
+
+	/**
+   * Next page number to issue readahead for
+	 */
+  PageId nextToIssue;
+
+	/**
+   * Highest valid page number in the file at scan start
+	 */
+  PageId lastPage;
+
+	/**
+   * Ring slot the next page will be delivered from
+	 */
+  std::uint32_t cursor;
+
+	/**
+   * Slot handed out by the previous next() call, recycled on the next one
+	 */
+  std::uint32_t deliveredSlot;
+
+  BulkScan(const BulkScan&);            // ring frames are not shareable
+  BulkScan& operator=(const BulkScan&); // ring frames are not shareable
+};
+
+
+/**
+ * @brief RAII pin on a buffer pool frame.
+ *
+ * The handle-returning overloads of BufMgr::readPage/allocPage hand one of
+ * these back so the caller can drop the pin through the frame number it
+ * already holds, skipping the hash table probe unPinPage needs to
+ * rediscover the frame. A handle still holding a pin releases it (clean)
+ * when destroyed.
+ */
+class PageHandle
+{
+ public:
+	/**
+   * Constructs an empty handle holding no pin
+	 */
+  PageHandle();
+
+	/**
+   * Takes over the pin held by another handle, leaving it empty
+	 *
+	 * @param other		Handle to take the pin from
+	 */
+  PageHandle(PageHandle&& other);
+
+	/**
+   * Drops any pin currently held, then takes over the other handle's pin
+	 *
+	 * @param other		Handle to take the pin from
+	 */
+  PageHandle& operator=(PageHandle&& other);
+
+	/**
+   * Releases the pin (clean) if still held
+	 */
+  ~PageHandle();
+
+	/**
+   * Returns the pinned page, or NULL for an empty handle
+	 */
+  Page* page() const { return pagePtr; }
+
+	/**
+   * Returns the pinned page, which must exist
+	 */
+  Page& operator*() const { return *pagePtr; }
+
+	/**
+   * Member access on the pinned page, which must exist
+	 */
+  Page* operator->() const { return pagePtr; }
+
+	/**
+   * Whether the handle currently holds a pin
+	 */
+  bool valid() const { return pagePtr != NULL; }
+
+	/**
+   * Releases the pin by decrementing the frame's pin count directly —
+	 * no hash table lookup. The handle becomes empty.
+	 *
+	 * @param dirty		True if the page needs to be marked dirty
+   * @throws  PageNotPinnedException If the frame's pin count is already 0
+	 */
+  void unpin(const bool dirty = false);
+
+ private:
+	/**
+   * Constructs a handle owning one pin on the given frame
+	 *
+	 * @param bufMgrIn	Buffer manager owning the frame
+	 * @param frameIn		Frame number the pin is held on
+	 * @param pageIn		Page held in the frame
+	 */
+  PageHandle(BufMgr* bufMgrIn, const FrameId frameIn, Page* pageIn);
+
+  PageHandle(const PageHandle&);            // pins are not copyable
+  PageHandle& operator=(const PageHandle&); // pins are not copyable
+
+	/**
+   * Buffer manager owning the pinned frame
+	 */
+  BufMgr* bufMgr;
+
+	/**
+   * Frame number the pin is held on
+	 */
+  FrameId frame;
+
+	/**
+   * Page held in the frame; NULL when the handle is empty
+	 */
+  Page* pagePtr;
+
+  friend class BufMgr;
+};
+
+
+/**
+ * @brief One named partition of a buffer pool: a name callers use as a
+ *        placement hint and the number of frames reserved for it.
+ *
+ * A pool built from a list of these splits its frames by the given quotas
+ * instead of equally. Pages read or allocated with a matching hint are
+ * faulted into that partition's frames, and its victim searches stay
+ * inside the quota unless the partition has nothing evictable, so a small
+ * hot partition (say, index pages) is not churned by bulk traffic in the
+ * others. Unhinted pages share the first partition in the list.
+ */
+struct NamedPartition
+{
+	/**
+	 * Name callers pass as the placement hint.
+	 */
+	std::string name;
+
+	/**
+	 * Number of frames reserved for the partition; at least 1.
+	 */
+	std::uint32_t frames;
+};
+
+
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
 */
@@ -170,130 +544,974 @@ class BufMgr
 {
  private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Sentinel frame number marking the end of a 2Q queue link
 	 */
-  FrameId clockHand;
+  static const FrameId NO_FRAME = 0xFFFFFFFF;
 
 	/**
-   * Number of frames in the buffer pool
+   * Sentinel partition index meaning "no placement hint"; allocPage
+	 * resolves it to the page's default placement once the new page number
+	 * is known
 	 */
-  std::uint32_t numBufs;
-	
+  static const std::uint32_t NO_PARTITION = 0xFFFFFFFF;
+
 	/**
-   * Hash table mapping (File, page) to frame
+   * Values for BufDesc::queue
 	 */
-  BufHashTbl *hashTable;
+  enum QueueId { QUEUE_NONE = 0, QUEUE_A1 = 1, QUEUE_AM = 2 };
 
 	/**
-   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+   * Replacement policy selected at construction
 	 */
-  BufDesc *bufDescTable;
+  ReplacementPolicy policy;
 
 	/**
-   * Maintains Buffer pool usage statistics 
+   * Number of frame partitions. Frames, their descriptors and the
+   * replacement state are split into contiguous partitions, one per NUMA
+   * node by default, with each partition's slab ranges bound to its node
+   * so victim searches and frame copies stay in local memory. A page's
+   * identity hashes to a home partition; victim searches start there and
+   * only steal from other partitions when home is exhausted.
 	 */
-  BufStats bufStats;
+  std::uint32_t numPartitions;
 
 	/**
-   * Advance clock to next frame in the buffer pool
+	 * Named-partition geometry: frame index where each partition starts,
+	 * with one trailing entry equal to capacityBufs. Empty unless the pool
+	 * was built from a NamedPartition list, in which case it replaces the
+	 * equal split that partitionStart() otherwise computes.
 	 */
-  void advanceClock();
+  std::vector<FrameId> partitionBounds;
 
 	/**
-	 * Allocate a free frame.  
-	 *
-	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 * Partition index by name, for resolving placement hints. Empty unless
+	 * the pool was built from a NamedPartition list.
 	 */
-  void allocBuf(FrameId & frame);
+  std::unordered_map<std::string, std::uint32_t> partitionNames;
 
- public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Per-partition position of the clock hand, each confined to its
+   * partition's frame range. Only mutated under the allocation latch;
+   * the background writer reads them unlatched, which is benign.
 	 */
-  Page* bufPool;
+  std::vector<FrameId> clockHands;
 
 	/**
-   * Constructor of BufMgr class
+   * Per-partition head/tail of the 2Q probation FIFO (A1); head is
+   * evicted first
 	 */
-  BufMgr(std::uint32_t bufs);
-	
+  std::vector<FrameId> a1Head, a1Tail;
+
 	/**
-   * Destructor of BufMgr class
+   * Per-partition head/tail of the 2Q protected LRU (Am); head is MRU,
+   * tail is LRU
 	 */
-  ~BufMgr();
+  std::vector<FrameId> amHead, amTail;
 
 	/**
-	 * Reads the given page from the file into a frame and returns the pointer to page.
-	 * If the requested page is already present in the buffer pool pointer to that frame is returned
-	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+   * Per-partition lists of frames not currently holding any page, handed
+   * out in O(1) by allocBuf without a victim search
+	 */
+  std::vector<std::vector<FrameId> > freeFrames;
+
+	/**
+	 * First frame of a partition.
 	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number in the file to be read
-	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param partition		Partition number
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+  FrameId partitionStart(const std::uint32_t partition) const
+	{
+		if (!partitionBounds.empty())
+		{
+			return partitionBounds[partition];
+		}
+		return (FrameId)(((std::uint64_t)partition * capacityBufs
+				+ numPartitions - 1) / numPartitions);
+	}
 
 	/**
-	 * Unpin a page from memory since it is no longer required for it to remain in memory.
+	 * One past the last frame of a partition.
 	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
-	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
-   * @throws  PageNotPinnedException If the page is not already pinned
+	 * @param partition		Partition number
 	 */
-  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+  FrameId partitionEnd(const std::uint32_t partition) const
+	{
+		return partitionStart(partition + 1);
+	}
 
 	/**
-	 * Allocates a new, empty page in the file and returns the Page object.
-	 * The newly allocated page is also assigned a frame in the buffer pool.
+	 * Partition owning a frame; inverse of the partitionStart() boundaries.
 	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
-	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 * @param frame		Frame number
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+  std::uint32_t partitionOfFrame(const FrameId frame) const
+	{
+		if (!partitionBounds.empty())
+		{ // quotas are few; a scan beats a binary search here
+			std::uint32_t p = 0;
+			while (p + 1 < numPartitions && partitionBounds[p + 1] <= frame)
+			{
+				p++;
+			}
+			return p;
+		}
+		return (std::uint32_t)((std::uint64_t)frame * numPartitions
+				/ capacityBufs);
+	}
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
-	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-	 * Otherwise Error returned.
+	 * Home partition of a page, by hashing its identity. Misses for the
+	 * page are faulted into this partition's frames when possible.
 	 *
-	 * @param file   	File object
-   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
-   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 * @param file		File owning the page
+	 * @param pageNo	Page number within the file
 	 */
-  void flushFile(const File* file);
+  std::uint32_t homePartition(const File* file, const PageId pageNo) const
+	{
+		if (!partitionBounds.empty())
+		{ // named pools: unhinted pages all share the first partition, so
+			// hinted partitions only churn on their own misses
+			return 0;
+		}
+		return (std::uint32_t)((file->fileId() * 0x9E3779B1u ^
+				pageNo * 0x85EBCA77u) % numPartitions);
+	}
 
 	/**
-	 * Delete page from file and also from buffer pool if present.
-	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 * Resolves a placement hint to a partition index; unknown names fall
+	 * back to the page's default placement.
 	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
+	 * @param hint		Partition name given by the caller
+	 * @param file		File owning the page
+	 * @param pageNo	Page number within the file
 	 */
-  void disposePage(File* file, const PageId PageNo);
+  std::uint32_t hintPartition(const std::string& hint, const File* file,
+			const PageId pageNo) const;
 
 	/**
-   * Print member variable values. 
+	 * Number of NUMA nodes the machine exposes, or 1 if that cannot be
+	 * determined.
 	 */
-  void  printSelf();
+  static std::uint32_t detectNumaNodes();
 
 	/**
-   * Get buffer pool usage statistics
+	 * Best-effort binding of each partition's byte range of a slab to that
+	 * partition's NUMA node. A no-op on single-node machines or where the
+	 * mbind syscall is unavailable; failures are ignored, costing only
+	 * locality.
+	 *
+	 * @param slab				Slab covering all partitions
+	 * @param elemBytes		Size of one frame-indexed element in the slab
 	 */
-  BufStats & getBufStats()
-  {
-		return bufStats;
-  }
+  void bindSlabToNodes(void* slab, const std::size_t elemBytes) const;
 
 	/**
-   * Clear buffer pool usage statistics
+   * Number of frames currently in circulation. Frames at and above this
+   * index are retired: invalid, off every free list and queue, and
+   * skipped by the victim searches. resize() moves this within
+   * [1, capacityBufs]; every other invariant is in terms of it.
 	 */
-  void clearBufStats() 
-  {
-		bufStats.clear();
-  }
+  std::uint32_t numBufs;
+
+	/**
+   * Number of frames the slabs were sized (and partitioned) for at
+   * construction. Partition geometry is fixed in terms of the capacity
+   * so resizing never re-homes a frame.
+	 */
+  std::uint32_t capacityBufs;
+	
+	/**
+   * Hash table mapping (File, page) to frame
+	 */
+  BufHashTbl *hashTable;
+
+	/**
+   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+	 */
+  BufDesc *bufDescTable;
+
+	/**
+   * Aggregated snapshot of the shard counters, refreshed by getBufStats()
+	 */
+  BufStats bufStats;
+
+	/**
+   * Compressed second-tier cache for evicted pages; disabled until
+   * setVictimCacheBytes() gives it a capacity.
+	 */
+  VictimCache victimCache;
+
+	/**
+   * Number of counter shards; threads are spread across them by thread id
+   * so the hot paths never contend on a shared cache line
+	 */
+  static const int NUM_STAT_SHARDS = 64;
+
+	/**
+	 * @brief One cache-line padded shard of the usage counters, updated
+	 * with relaxed atomic adds. Padded out to a multiple of 64 bytes so
+	 * neighbouring shards never share a cache line.
+	 */
+  struct StatsShard
+  {
+		std::atomic<std::uint64_t> accesses;
+		std::atomic<std::uint64_t> hits;
+		std::atomic<std::uint64_t> misses;
+		std::atomic<std::uint64_t> diskreads;
+		std::atomic<std::uint64_t> diskwrites;
+		std::atomic<std::uint64_t> evictions;
+		std::atomic<std::uint64_t> evictionsClean;
+		std::atomic<std::uint64_t> evictionsDirty;
+		std::atomic<std::uint64_t> victimSearches;
+		std::atomic<std::uint64_t> framesInspected;
+		std::atomic<std::uint64_t> pinSkips;
+		std::atomic<std::uint64_t> allocFailures;
+		std::atomic<std::uint64_t> victimSearchCycles;
+		std::atomic<std::uint64_t> missLatency[BufStats::LATENCY_BUCKETS];
+		std::atomic<std::uint64_t> sweepLength[BufStats::SWEEP_BUCKETS];
+		char pad[64 - ((13 + BufStats::LATENCY_BUCKETS + BufStats::SWEEP_BUCKETS)
+				* sizeof(std::uint64_t)) % 64];
+  };
+
+	/**
+   * The counter shards
+	 */
+  StatsShard statsShards[NUM_STAT_SHARDS];
+
+	/**
+   * Returns the calling thread's counter shard
+	 */
+  StatsShard& statsShard();
+
+	/**
+   * Maps a miss service time to its histogram bucket
+	 *
+	 * @param micros	Service time in microseconds
+	 */
+  static int latencyBucket(std::uint64_t micros);
+
+	/**
+   * Bytes actually mapped for the buffer pool slab (rounded up to the
+   * huge page size), needed for the munmap at teardown
+	 */
+  std::size_t bufPoolSlabBytes;
+
+	/**
+   * Bytes actually mapped for the frame descriptor slab
+	 */
+  std::size_t descSlabBytes;
+
+	/**
+   * Maps an anonymous slab rounded up to 2MB huge page granularity and
+	 * advises the kernel to back it with huge pages where supported, so
+	 * large pools stop thrashing the dTLB on random frame access. The
+	 * mapping is page-aligned, which also gives every cache-line padded
+	 * BufDesc its natural 64-byte alignment.
+	 *
+	 * @param bytes		Requested size; rounded up to the slab granularity
+	 * @return 				The mapping
+   * @throws  std::bad_alloc If the mapping cannot be established
+	 */
+  static void* mapSlab(std::size_t& bytes);
+
+	/**
+   * Unmaps a slab obtained from mapSlab().
+	 *
+	 * @param slab		The mapping
+	 * @param bytes		Mapped size as adjusted by mapSlab()
+	 */
+  static void unmapSlab(void* slab, const std::size_t bytes);
+
+	/**
+   * Latch serializing frame allocation (the clock sweep) and other
+   * structural changes to the pool. The page hit path does not take it;
+   * hits only touch the hash table stripe latch and the frame's atomics,
+   * so threads pinning independent resident pages do not contend here.
+	 */
+  std::mutex allocLatch;
+
+	/**
+   * Thread running backgroundWriterMain() when the background writer is
+   * enabled.
+	 */
+  std::thread writerThread;
+
+	/**
+   * True while the background writer should keep running.
+	 */
+  std::atomic<bool> writerRunning;
+
+	/**
+   * Wakes the background writer when the clock hand moves.
+	 */
+  std::condition_variable writerCv;
+
+	/**
+   * Protects writerCv.
+	 */
+  std::mutex writerMutex;
+
+	/**
+   * Advance a partition's clock hand to the next frame of the partition
+	 *
+	 * @param partition		Partition whose hand to advance
+	 */
+  void advanceClock(const std::uint32_t partition);
+
+	/**
+	 * Main loop of the background writer: sweeps a window of frames ahead of
+	 * the clock hand and writes back dirty, unpinned frames, so that by the
+	 * time the clock hand reaches them eviction is a clean in-memory
+	 * operation instead of a synchronous disk write.
+	 */
+  void backgroundWriterMain();
+
+	/**
+	 * @brief One queued readahead request.
+	 */
+  struct PrefetchRequest
+	{
+		/**
+	   * File whose pages should be prefetched
+		 */
+		File* file;
+
+		/**
+	   * First page number to prefetch
+		 */
+		PageId firstPage;
+
+		/**
+	   * Number of consecutive pages to prefetch
+		 */
+		std::uint32_t count;
+	};
+
+	/**
+   * Queued readahead requests, serviced by the prefetch thread.
+	 */
+  std::deque<PrefetchRequest> prefetchQueue;
+
+	/**
+   * Thread running prefetchMain() once the first request is queued.
+	 */
+  std::thread prefetchThread;
+
+	/**
+   * True while the prefetch thread should keep running.
+	 */
+  std::atomic<bool> prefetchRunning;
+
+	/**
+   * Wakes the prefetch thread when a request is queued.
+	 */
+  std::condition_variable prefetchCv;
+
+	/**
+   * Protects prefetchQueue and prefetchCv.
+	 */
+  std::mutex prefetchMutex;
+
+	/**
+	 * Main loop of the prefetch thread: pops queued requests and faults the
+	 * pages into the pool unpinned, so later readPage calls for them hit.
+	 */
+  void prefetchMain();
+
+	/**
+	 * Stops and joins the prefetch thread if it is running.
+	 */
+  void stopPrefetcher();
+
+	/**
+	 * Allocate a free frame using the selected replacement policy, starting
+	 * the victim search in the page's home partition and stealing from the
+	 * other partitions only when home has no evictable frame.
+	 *
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param partition	Home partition to search first
+	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 */
+  void allocBuf(FrameId & frame, const std::uint32_t partition);
+
+	/**
+	 * Clock victim search confined to one partition.
+	 *
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param partition	Partition to search
+	 * @param inspected	Incremented per frame the sweep inspected
+	 * @param pinSkips	Incremented per frame skipped because it was pinned
+	 * @return	True if a frame was allocated
+	 */
+  bool allocBufClockIn(FrameId & frame, const std::uint32_t partition,
+                       std::uint64_t & inspected, std::uint64_t & pinSkips);
+
+	/**
+	 * Victim search for the 2Q policy, confined to one partition: drains
+	 * free frames first, then evicts from the probation FIFO, promoting
+	 * re-referenced frames to the protected LRU on the way, and falls back
+	 * to the protected LRU tail.
+	 *
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param partition	Partition to search
+	 * @param inspected	Incremented per frame the search inspected
+	 * @param pinSkips	Incremented per frame rotated because it was pinned
+	 * @return	True if a frame was allocated
+	 */
+  bool allocBufTwoQIn(FrameId & frame, const std::uint32_t partition,
+                      std::uint64_t & inspected, std::uint64_t & pinSkips);
+
+	/**
+	 * Writes the frame back if dirty and removes its page-table entry.
+	 * Caller must hold the allocation latch and the frame latch.
+	 *
+	 * @param frame   Frame to evict
+	 */
+  void evictFrame(const FrameId frame);
+
+	/**
+	 * Unlinks the frame from whichever 2Q queue it is in, if any.
+	 * Caller must hold the allocation latch.
+	 *
+	 * @param frame   Frame to unlink
+	 */
+  void listRemove(const FrameId frame);
+
+	/**
+	 * Links the frame at the tail of the probation FIFO (A1).
+	 * Caller must hold the allocation latch.
+	 *
+	 * @param frame   Frame to link
+	 */
+  void listPushA1Tail(const FrameId frame);
+
+	/**
+	 * Links the frame at the MRU head of the protected LRU (Am).
+	 * Caller must hold the allocation latch.
+	 *
+	 * @param frame   Frame to link
+	 */
+  void listPushAmHead(const FrameId frame);
+
+	/**
+	 * Policy bookkeeping for a frame that just received a page.
+	 * Caller must hold the allocation latch.
+	 *
+	 * @param frame   Frame that was paged in
+	 */
+  void policyPagedIn(const FrameId frame);
+
+	/**
+	 * Policy bookkeeping for a frame whose page was discarded (Clear()ed
+	 * outside a victim search). Caller must hold the allocation latch.
+	 *
+	 * @param frame   Frame that was emptied
+	 */
+  void policyRemoved(const FrameId frame);
+
+	/**
+	 * Frames currently owned by each open file (keyed by interned file id,
+	 * so aliasing File objects share one list), so flushFile/disposePage
+	 * visit only a file's own frames instead of sweeping the whole pool.
+	 * Maintained alongside Set()/Clear() under the allocation latch.
+	 */
+  std::unordered_map<FileId, std::vector<FrameId> > fileFrames;
+
+	/**
+	 * Files opened by warmStart(). They stay open for the life of the
+	 * buffer manager so the frame descriptors filled during warm start
+	 * never point at a closed file, even if the application has not opened
+	 * that file yet itself.
+	 */
+  std::vector<std::shared_ptr<File> > warmStartFiles;
+
+	/**
+   * Files reopened while adopting frames from a shared-memory segment,
+   * held so the adopted File pointers stay valid for the pool's life.
+	 */
+  std::vector<std::shared_ptr<File> > adoptFiles;
+
+	/**
+   * Name of the shared-memory segment backing the pool, or empty for a
+   * private pool.
+	 */
+  std::string shmName;
+
+	/**
+   * Base of the shared-memory mapping (header + directory + frames), or
+   * NULL for a private pool.
+	 */
+  void* shmBase;
+
+	/**
+   * Size of the shared-memory mapping in bytes.
+	 */
+  std::size_t shmBytes;
+
+	/**
+   * Descriptor of the shared-memory segment, or -1.
+	 */
+  int shmFd;
+
+	/**
+   * Per-frame identity directory inside the segment (cast to
+   * SharedFrameDir in the translation unit), or NULL.
+	 */
+  void* shmDir;
+
+	/**
+   * Whether construction reattached to an existing segment.
+	 */
+  bool shmAdopted;
+
+	/**
+   * Shared construction body of both constructors.
+	 *
+	 * @param bufs	Number of frames in the buffer pool
+	 */
+  void construct(const std::uint32_t bufs, const std::uint32_t numPartitionsIn);
+
+	/**
+   * Maps (creating or reattaching) the shared-memory segment and points
+	 * bufPool and shmDir into it; sets shmAdopted when an existing segment
+	 * with matching geometry was found.
+	 */
+  void mapSharedPool();
+
+	/**
+   * Repins nothing, reads nothing: installs every frame the shared
+	 * directory records as valid and clean into the hash table, the
+	 * descriptors and the policy lists, reopening the named files.
+	 */
+  void adoptSharedFrames();
+
+	/**
+   * Records frame identity (file name, page number, clean) in the shared
+	 * directory after a Set(); no-op for private pools.
+	 *
+	 * @param frame		Frame just set up
+	 */
+  void publishFrame(const FrameId frame);
+
+	/**
+   * Marks a frame's directory entry invalid; no-op for private pools.
+	 *
+	 * @param frame		Frame being evicted or cleared
+	 */
+  void unpublishFrame(const FrameId frame);
+
+	/**
+   * Tracks the dirty flag in the shared directory so adoption after a
+	 * restart can skip frames whose bytes were never written back; no-op
+	 * for private pools.
+	 *
+	 * @param frame		Frame whose dirty state changed
+	 * @param dirty		New dirty state
+	 */
+  void markFrameDirty(const FrameId frame, const bool dirty);
+
+	/**
+	 * Records that a frame now holds a page of the given file.
+	 * Caller must hold the allocation latch.
+	 *
+	 * @param file		File owning the page
+	 * @param frame   Frame holding the page
+	 */
+  void fileIndexAdd(const File* file, const FrameId frame);
+
+	/**
+	 * Records that a frame no longer holds a page of the given file.
+	 * Caller must hold the allocation latch.
+	 *
+	 * @param file		File that owned the page
+	 * @param frame   Frame that held the page
+	 */
+  void fileIndexRemove(const File* file, const FrameId frame);
+
+	/**
+	 * Body shared by both readPage overloads; pins the page and returns the
+	 * frame holding it, or NO_FRAME if the pool had no evictable frame.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference through which the pinned page is returned
+	 */
+  FrameId readPageInternal(File* file, const PageId PageNo, Page*& page,
+                           const std::uint32_t partition);
+
+	/**
+	 * Body shared by both allocPage overloads; allocates and pins the page
+	 * and returns the frame holding it.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Reference through which the new page number is returned
+	 * @param page  	Reference through which the pinned page is returned
+	 */
+  FrameId allocPageInternal(File* file, PageId &PageNo, Page*& page,
+                            const std::uint32_t partition);
+
+	/**
+	 * Drops one pin on a frame the caller already identified (PageHandle
+	 * release path — no hash table lookup).
+	 *
+	 * @param frame		Frame to unpin
+	 * @param dirty		True if the page needs to be marked dirty
+   * @throws  PageNotPinnedException If the frame's pin count is already 0
+	 */
+  void unpinFrame(const FrameId frame, const bool dirty);
+
+  friend class PageHandle;
+
+ public:
+	/**
+   * Actual buffer pool from which frames are allocated
+	 */
+  Page* bufPool;
+
+	/**
+   * Constructor of BufMgr class
+	 *
+	 * @param bufs							Number of frames in the buffer pool
+	 * @param policyIn					Replacement policy; defaults to the classic clock
+	 * @param numPartitionsIn		Frame partitions; 0 (the default) means one
+	 *													per NUMA node of the machine
+	 */
+  BufMgr(std::uint32_t bufs, ReplacementPolicy policyIn = POLICY_CLOCK,
+         std::uint32_t numPartitionsIn = 0);
+
+	/**
+   * As BufMgr(bufs, policyIn, numPartitionsIn), but places the frame pool
+	 * and a per-frame identity directory in the named POSIX shared-memory
+	 * segment (a shm_open() name, e.g. "/badgerdb_pool"), creating it if
+	 * needed. Exactly one BufMgr may manage a segment at a time — the
+	 * descriptors, page table and latches stay process-private — but the
+	 * segment outlives the process, and a new BufMgr constructed over it
+	 * with the same geometry adopts every frame the directory records as
+	 * valid and clean: the pool comes back warm with no disk I/O at all.
+	 * Intended for clean-shutdown restarts; after a crash, call
+	 * removeSharedPool() and start cold instead of trusting the directory.
+	 *
+	 * @param bufs							Number of frames in the buffer pool
+	 * @param shmNameIn					Name of the shared-memory segment
+	 * @param policyIn					Replacement policy; defaults to the classic clock
+	 * @param numPartitionsIn		Frame partitions; 0 (the default) means one
+	 *													per NUMA node of the machine
+	 */
+  BufMgr(std::uint32_t bufs, const std::string& shmNameIn,
+         ReplacementPolicy policyIn = POLICY_CLOCK,
+         std::uint32_t numPartitionsIn = 0);
+
+	/**
+   * Builds a pool whose frames are split into the given named partitions
+	 * by quota rather than equally; the pool holds the sum of the quotas.
+	 * Callers route pages into a partition by passing its name to the
+	 * hinted readPage/allocPage overloads; unhinted pages share the first
+	 * partition in the list. A hinted miss only steals a frame from
+	 * another partition when its own has nothing evictable, and vice
+	 * versa, so quotas bound churn rather than hard-capping residency.
+	 * Named partitioning replaces the NUMA-based split.
+	 *
+	 * @param partitionsIn			Named partitions and their frame quotas
+	 * @param policyIn					Replacement policy; defaults to the classic clock
+	 */
+  BufMgr(const std::vector<NamedPartition>& partitionsIn,
+         ReplacementPolicy policyIn = POLICY_CLOCK);
+
+	/**
+   * Unlinks a shared-memory pool segment so the next BufMgr over the
+	 * name starts cold. The segment of a live BufMgr stays mapped.
+	 *
+	 * @param shmName		Name of the shared-memory segment
+	 */
+  static void removeSharedPool(const std::string& shmName);
+
+	/**
+   * Returns true if this pool reattached to an existing shared-memory
+	 * segment and adopted its frames.
+	 */
+  bool sharedPoolAdopted() const { return shmAdopted; }
+	
+	/**
+   * Destructor of BufMgr class
+	 */
+  ~BufMgr();
+
+	/**
+	 * Reads the given page from the file into a frame and returns the pointer to page.
+	 * If the requested page is already present in the buffer pool pointer to that frame is returned
+	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page);
+
+	/**
+	 * As readPage(File*, PageId, Page*&), but returns an RAII handle whose
+	 * unpin(dirty) releases the pin without the hash table lookup that
+	 * unPinPage performs. Returns an empty handle if the pool had no
+	 * evictable frame.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @return 				Handle owning one pin on the page
+	 */
+  PageHandle readPage(File* file, const PageId PageNo);
+
+	/**
+	 * As readPage(File*, PageId, Page*&), but a miss faults the page into
+	 * the named partition's frames instead of the page's default
+	 * placement. Only meaningful on pools built from a NamedPartition
+	 * list; unknown names fall back to the default placement. Hits are
+	 * served from whatever frame holds the page, wherever it lives.
+	 *
+	 * @param file   		File object
+	 * @param PageNo  	Page number in the file to be read
+	 * @param page  		Reference to page pointer for the requested page
+	 * @param partition	Name of the partition to fault the page into
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page,
+                const std::string& partition);
+
+	/**
+	 * Pins a batch of pages of one file in a single pass: residency is
+	 * probed for the whole batch first, then the misses are faulted in
+	 * together under one acquisition of the allocation latch with their
+	 * reads issued concurrently on the I/O engine, and the statistics
+	 * counters are updated once for the batch. On failure (no evictable
+	 * frame, or a page that does not exist) every pin the batch took is
+	 * released before the exception propagates, so the batch pins all of
+	 * its pages or none of them.
+	 *
+	 * @param file   	File object
+	 * @param pageNos	Page numbers to pin
+	 * @param count  	Number of entries in pageNos and pages
+	 * @param pages  	Receives a pinned Page pointer per entry
+   * @throws  BufferExceededException If no frame can be evicted for a miss
+   * @throws  InvalidPageException If one of the pages does not exist
+	 */
+  void readPages(File* file, const PageId* pageNos, const std::size_t count,
+                 Page** pages);
+
+	/**
+	 * As readPage(File*, PageId, Page*&), but non-blocking on a miss: the
+	 * returned future resolves to the pinned page once the disk read has
+	 * completed on the I/O engine, so one thread can keep many page
+	 * fetches in flight and overlap computation with I/O. Hits (and
+	 * mapped files, and victim cache hits) resolve the future immediately
+	 * without touching the engine. The caller owns one pin on the page the
+	 * future delivers and releases it with unPinPage as usual.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @return 				Future resolving to a pointer to the pinned page
+   * @throws  BufferExceededException (from the future) if no frame could
+   *          be evicted for a miss
+   * @throws  InvalidPageException (from the future) if the page does not
+   *          exist
+	 */
+  std::future<Page*> readPageAsync(File* file, const PageId PageNo);
+
+	/**
+	 * Queues pages [first, first+count) of the file for asynchronous
+	 * readahead. The pages are faulted into buffer pool frames unpinned and
+	 * inserted into the hash table as they arrive; a later readPage for one
+	 * of them pins it with a plain buffer hit. Pages already resident are
+	 * skipped, and the request is abandoned quietly if the pool runs out of
+	 * evictable frames or the range runs past the end of the file.
+	 *
+	 * @param file   	File object
+	 * @param first   First page number to prefetch
+	 * @param count  	Number of consecutive pages to prefetch
+	 */
+  void prefetchPages(File* file, const PageId first, const std::uint32_t count);
+
+	/**
+	 * Unpin a page from memory since it is no longer required for it to remain in memory.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+   * @throws  PageNotPinnedException If the page is not already pinned
+	 */
+  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+
+	/**
+	 * Unpins a batch of pages pinned with readPages (or individually).
+	 * Each page is unpinned in order; the first PageNotPinnedException
+	 * aborts the batch and propagates.
+	 *
+	 * @param file   	File object
+	 * @param pageNos	Page numbers to unpin
+	 * @param count  	Number of entries in pageNos
+	 * @param dirty		True if the pages need to be marked dirty
+   * @throws  PageNotPinnedException If one of the pages is not pinned
+	 */
+  void unPinPages(File* file, const PageId* pageNos, const std::size_t count,
+                  const bool dirty);
+
+	/**
+	 * Allocates a new, empty page in the file and returns the Page object.
+	 * The newly allocated page is also assigned a frame in the buffer pool.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 */
+  void allocPage(File* file, PageId &PageNo, Page*& page); 
+
+	/**
+	 * As allocPage(File*, PageId&, Page*&), but returns an RAII handle whose
+	 * unpin(dirty) releases the pin without a hash table lookup.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Reference through which the new page number is returned
+	 * @return 				Handle owning one pin on the new page
+	 */
+  PageHandle allocPage(File* file, PageId &PageNo);
+
+	/**
+	 * As allocPage(File*, PageId&, Page*&), but the new page's frame is
+	 * taken from the named partition instead of the page's default
+	 * placement. Only meaningful on pools built from a NamedPartition
+	 * list; unknown names fall back to the default placement.
+	 *
+	 * @param file   		File object
+	 * @param PageNo  	Page number of the newly allocated page
+	 * @param page  		Pointer to the newly allocated page
+	 * @param partition	Name of the partition to place the page in
+	 */
+  void allocPage(File* file, PageId &PageNo, Page*& page,
+                 const std::string& partition);
+
+	/**
+	 * Writes out all dirty pages of the file to disk.
+	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
+	 * Otherwise Error returned.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+  void flushFile(const File* file);
+
+	/**
+	 * Flushes several files at once from a small worker pool, keeping
+	 * multiple write streams in flight (a checkpoint over many files is
+	 * bound by per-file flush latency through the serial path). Waits for
+	 * every flush to finish; if any of them threw, the first exception is
+	 * rethrown after the rest have completed.
+	 *
+	 * @param files		Files to flush
+   * @throws  PagePinnedException If any page of a file is pinned in the buffer pool
+   * @throws BadBufferException If any frame allocated to a file is found to be invalid
+	 */
+  void flushAll(const std::vector<File*>& files);
+
+	/**
+	 * As flushAll(files), but flushes every file that currently owns a
+	 * frame in the pool.
+	 */
+  void flushAll();
+
+	/**
+	 * Changes the number of frames in circulation without a restart.
+	 * Shrinking drains the trimmed tail frames — dirty pages are written
+	 * back, resident pages evicted — and releases their memory to the OS;
+	 * growing puts the frames (zeroed) back into circulation. Pinned pages
+	 * are never invalidated: a pinned page in the trimmed range aborts the
+	 * shrink before anything changes. The pool cannot grow beyond the
+	 * frame count it was constructed with.
+	 *
+	 * @param newNumBufs	New number of frames, in [1, construction size]
+   * @throws  PagePinnedException If a page in the trimmed range is pinned
+   * @throws  BufferExceededException If newNumBufs is 0 or exceeds the
+   *          construction-time capacity
+	 */
+  void resize(const std::uint32_t newNumBufs);
+
+	/**
+	 * Delete page from file and also from buffer pool if present.
+	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 */
+  void disposePage(File* file, const PageId PageNo);
+
+	/**
+	 * Sets the compressed victim cache capacity in bytes (0, the default,
+	 * disables it). While enabled, evicted pages are kept compressed in a
+	 * second tier that is checked before disk on every miss, so recently
+	 * evicted pages come back at decompression cost instead of a full
+	 * read.
+	 *
+	 * @param maxBytes	Capacity in bytes of compressed page data
+	 */
+  void setVictimCacheBytes(const std::size_t maxBytes);
+
+	/**
+	 * Returns the victim cache counters: hits served from the compressed
+	 * tier, pages stored on eviction, and entries recycled for space.
+	 *
+	 * @param hits		Receives the hit count
+	 * @param stores		Receives the store count
+	 * @param evictions	Receives the recycle count
+	 */
+  void getVictimCacheStats(std::uint64_t & hits, std::uint64_t & stores,
+			std::uint64_t & evictions);
+
+	/**
+	 * Starts the background writer thread. Until stopped, it flushes dirty
+	 * unpinned frames just ahead of the clock hand so foreground misses
+	 * rarely stall on a victim writeback.
+	 */
+  void startBackgroundWriter();
+
+	/**
+	 * Stops and joins the background writer thread if it is running.
+	 */
+  void stopBackgroundWriter();
+
+	/**
+	 * Writes the (filename, page number) identity of every valid frame to
+	 * a sidecar file so a future BufMgr can repopulate the pool with
+	 * warmStart(). Call at shutdown, or periodically for crash tolerance;
+	 * the sidecar is replaced atomically via rename. I/O errors are
+	 * swallowed — a stale or missing snapshot only costs warm-up time.
+	 *
+	 * @param path		Sidecar file to write
+	 */
+  void saveWarmStartState(const std::string& path);
+
+	/**
+	 * Repopulates the pool from a sidecar written by saveWarmStartState().
+	 * Pages are reloaded grouped by file and sorted by page number so the
+	 * refill runs as sequential reads. A missing sidecar, missing files
+	 * and since-deleted pages are skipped silently; at most numBufs pages
+	 * are loaded. Intended to be called right after construction, before
+	 * the pool sees traffic.
+	 *
+	 * @param path		Sidecar file written by a previous run
+	 */
+  void warmStart(const std::string& path);
+
+	/**
+   * Print member variable values.
+	 */
+  void  printSelf();
+
+	/**
+   * Get buffer pool usage statistics, aggregated across the counter
+   * shards at the time of the call
+	 */
+  BufStats & getBufStats();
+
+	/**
+   * Clear buffer pool usage statistics
+	 */
+  void clearBufStats();
 };
 
 }
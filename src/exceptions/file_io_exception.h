@@ -0,0 +1,55 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a read or write syscall on a file
+ *        fails with a hard error (e.g. ENOSPC or EIO), so the transfer could
+ *        not be completed.
+ */
+class FileIoException : public BadgerDbException {
+ public:
+  /**
+   * Constructs an I/O exception for the given file and failed operation.
+   *
+   * @param name       Name of the file the operation failed on.
+   * @param operation  The syscall that failed (e.g. "pwrite").
+   * @param error      The errno value reported by the syscall.
+   */
+  FileIoException(const std::string& name, const std::string& operation,
+                  const int error);
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+  /**
+   * Returns the errno value the failed syscall reported.
+   */
+  virtual int error() const { return error_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+
+  /**
+   * The errno value the failed syscall reported.
+   */
+  const int error_;
+};
+
+}
@@ -0,0 +1,60 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a page read back from disk fails
+ *        its CRC32C checksum, i.e. the stored bytes were silently corrupted.
+ */
+class PageChecksumException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a checksum exception for the given page number and filename.
+   *
+   * @param requested_number  Number of the corrupted page.
+   * @param file              Name of file the page was read from.
+   */
+  PageChecksumException(const PageId requested_number,
+                        const std::string& file);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~PageChecksumException() throw() {}
+
+  /**
+   * Returns the number of the corrupted page.
+   */
+  virtual PageId page_number() const { return page_number_; }
+
+  /**
+   * Returns name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+ protected:
+  /**
+   * Number of the corrupted page.
+   */
+  const PageId page_number_;
+
+  /**
+   * Name of file which caused this exception.
+   */
+  const std::string filename_;
+};
+
+}
@@ -7,10 +7,18 @@
 
 #pragma once
 
-#include <fstream>
+#include <atomic>
+#include <future>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/uio.h>
 
 #include "page.h"
 
@@ -60,18 +68,53 @@ struct FileHeader {
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
- * fixed-sized pages, and they never deallocate space (though they do reuse
- * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * The File class wraps a file descriptor for an underlying file on disk.
+ * Files contain fixed-sized pages, and they never deallocate space (though
+ * they do reuse deleted pages if possible).  If multiple File objects refer
+ * to the same underlying file, they will share the descriptor.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the open_fds_ map) and just returns a file object with
+ * the already opened descriptor for the file without actually opening the UNIX file again.
  *
- * @warning This class is not threadsafe.
+ * All page I/O uses positional pread/pwrite, so there is no shared seek
+ * position: multiple threads may read different pages of one file
+ * simultaneously, each with a single syscall.
  */
 class File {
  public:
+  /**
+   * How page checksums are verified on read.  Checksums are always
+   * computed and stored on write; this only controls the read side.
+   */
+  enum ChecksumMode {
+    CHECKSUM_OFF,      // trust the disk; no verification
+    CHECKSUM_SYNC,     // verify inline; mismatches throw
+    CHECKSUM_DEFERRED  // verify on the I/O engine; mismatches are counted
+  };
+
+  /**
+   * Sets the process-wide checksum verification mode.  CHECKSUM_SYNC
+   * (the default) verifies in the reading thread and throws
+   * PageChecksumException on a mismatch.  CHECKSUM_DEFERRED snapshots
+   * the page and queues the verification on the I/O engine, keeping the
+   * foreground read path latency-neutral; mismatches then only bump the
+   * failure counter, so they are detected but not prevented.
+   *
+   * @param mode  New verification mode.
+   */
+  static void setChecksumMode(const ChecksumMode mode);
+
+  /**
+   * Returns the current checksum verification mode.
+   */
+  static ChecksumMode checksumMode();
+
+  /**
+   * Returns the number of checksum mismatches detected by deferred
+   * verification since process start.
+   */
+  static std::uint64_t checksumFailures();
+
   /**
    * Creates a new file.
    *
@@ -92,6 +135,49 @@ class File {
    */
   static File open(const std::string& filename);
 
+  /**
+   * Opens the file named <filename> in mmap-backed read mode and returns
+   * the associated File object.  Page reads are served as zero-copy views
+   * over the shared mapping instead of being copied out of the file, so
+   * read-mostly data is held once in the OS page cache rather than
+   * buffered again on the heap.  The pages behind the views must not be
+   * modified; writes through the regular API remain visible in the
+   * mapping.  The file must exist already.
+   *
+   * @see pageView()
+   * @param filename  Name of the file.
+   * @return  File object for the newly opened file.
+   * @throws  FileNotFoundException   If the requested file doesn't exist.
+   */
+  static File openMapped(const std::string& filename);
+
+  /**
+   * Creates a new file in direct I/O mode.  The file uses a block-aligned
+   * layout (the file header is padded out to a full DIRECT_BLOCK and every
+   * page starts on a block boundary) and page I/O bypasses the OS page
+   * cache via O_DIRECT, so pages are cached once, in the buffer pool,
+   * instead of twice.  Files created this way must always be opened with
+   * openDirect().
+   *
+   * If the filesystem rejects O_DIRECT (e.g. tmpfs) or the page size is
+   * not a multiple of DIRECT_BLOCK, the file silently falls back to
+   * buffered I/O; the aligned layout is kept in the first case so the
+   * file stays readable either way.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileExistsException     If the requested file already exists.
+   */
+  static File createDirect(const std::string& filename);
+
+  /**
+   * Opens an existing direct-mode file.
+   *
+   * @see createDirect()
+   * @param filename  Name of the file.
+   * @throws  FileNotFoundException   If the requested file doesn't exist.
+   */
+  static File openDirect(const std::string& filename);
+
   /**
    * Deletes an existing file.
    *
@@ -145,6 +231,17 @@ class File {
    */
   Page allocatePage();
 
+  /**
+   * Allocates <count> new pages at the end of the file as one contiguous
+   * extent and appends them to the used-page list in order.  Intended for
+   * bulk loads; the free list is deliberately not consulted so the extent
+   * stays contiguous on disk.
+   *
+   * @param count   Number of pages to allocate.
+   * @param pages   Vector the newly allocated pages are returned in.
+   */
+  void allocatePages(const std::uint32_t count, std::vector<Page>& pages);
+
   /**
    * Reads an existing page from the file.
    *
@@ -155,6 +252,31 @@ class File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file directly into the given Page
+   * object, e.g. a buffer pool frame.  This avoids the intermediate copy
+   * that the by-value overload makes on every call.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page object to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page& page) const;
+
+  /**
+   * Queues an asynchronous read of the given page into the given Page
+   * object on the I/O engine.  The returned completion token becomes ready
+   * when the read has finished; exceptions the read raises (e.g.
+   * InvalidPageException) are rethrown when the token is waited on.  The
+   * destination must stay valid until completion.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page object to read into.
+   * @return  Completion token for the read.
+   */
+  std::future<void> readPageAsync(const PageId page_number, Page& page) const;
+
   /**
    * Writes a page into the file, replacing any existing contents.  The page
    * must have been already allocated in this file by a call to allocatePage().
@@ -165,12 +287,71 @@ class File {
   void writePage(const Page& new_page);
 
   /**
-   * Deletes a page from the file.
+   * Queues an asynchronous write of the given page on the I/O engine.  The
+   * returned completion token becomes ready when the write has finished.
+   * The page must stay valid and unmodified until completion.
+   *
+   * @see writePage(const Page&)
+   * @param new_page  Page to write.
+   * @return  Completion token for the write.
+   */
+  std::future<void> writePageAsync(const Page& new_page);
+
+  /**
+   * Writes a run of pages with consecutive page numbers in one vectored
+   * write, replacing any existing contents.  Every page must have been
+   * already allocated in this file, and pages[i + 1] must hold the page
+   * numbered one past pages[i].  Used by buffer flushes to turn scattered
+   * per-page writes into sequential streaming.
+   *
+   * @see writePage(const Page&)
+   * @param pages   Pages to write, ordered by consecutive page number.
+   */
+  void writePages(const std::vector<const Page*>& pages);
+
+  /**
+   * Deletes a page from the file.  Costs O(1) page I/Os: the predecessor
+   * in the used-page list comes from a cached predecessor map instead of
+   * a walk of the list.
    *
    * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page doesn't exist in the file
+   *                                or is not currently used.
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Deletes <count> pages with consecutive page numbers, e.g. an extent
+   * from allocatePages() when a partition is dropped.  Unlinks every page
+   * and pushes it onto the free list, but rewrites the file header only
+   * once at the end.
+   *
+   * @see deletePage()
+   * @param first_page_number   Number of first page to delete.
+   * @param count               Number of consecutive pages to delete.
+   * @throws  InvalidPageException  If any page in the range doesn't exist
+   *                                in the file or is not currently used.
+   */
+  void deletePages(const PageId first_page_number, const std::uint32_t count);
+
+  /**
+   * Returns the number of a used page with at least <length> bytes of
+   * reusable space for a record, or Page::INVALID_NUMBER if no such page
+   * exists and the caller should allocate a fresh one.  Backed by a
+   * per-file free-space map: a coarse bucket of each used page's
+   * reusable space (free bytes plus reclaimable dead space), primed with
+   * one walk of the page-header chain and maintained as headers are
+   * written, so inserts go straight to a page that fits instead of
+   * pinning and rejecting candidates.  The answer is conservative — it
+   * accounts for a new slot entry — and may miss a page whose space
+   * straddles a bucket boundary.
+   *
+   * @param length  Length of the record data to place.
+   * @return  Number of a page the record is guaranteed to fit in, or
+   *          Page::INVALID_NUMBER.
+   */
+  PageId findPageWithSpace(const std::size_t length);
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -178,6 +359,36 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns the dense id interned for this file's name.  All File objects
+   * for the same underlying file share one id, so it is safe to key page
+   * tables and other per-file indexes on it where the object address is
+   * not.
+   */
+  FileId fileId() const { return id_; }
+
+  /**
+   * Returns true if the file is backed by a shared mapping.
+   */
+  bool isMapped() const { return state_ != NULL && state_->mapped; }
+
+  /**
+   * Returns true if page I/O on this file bypasses the OS page cache.
+   */
+  bool isDirect() const { return state_ != NULL && state_->directIo; }
+
+  /**
+   * Returns a read-only view of the given page inside the file's mapping,
+   * growing the mapping first if the file has gained pages since it was
+   * established.  Only valid on files opened with openMapped().
+   *
+   * @param page_number   Number of page to view.
+   * @return  The page, in place in the mapping.
+   * @throws  InvalidPageException  If the page is free (unused) or past
+   *                                the end of the file.
+   */
+  const Page* pageView(const PageId page_number) const;
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -194,15 +405,31 @@ class File {
   FileIterator end();
 
  private:
+  /**
+   * Alignment unit for direct I/O: offsets, lengths and buffers handed to
+   * an O_DIRECT descriptor must all be multiples of this.
+   */
+  static const std::size_t DIRECT_BLOCK = 4096;
+
+  /**
+   * Size of the per-thread bounce buffer used to align direct transfers;
+   * always a multiple of DIRECT_BLOCK and at least one page.
+   */
+  static const std::size_t DIRECT_CHUNK =
+      Page::SIZE > 65536 ? (std::size_t)Page::SIZE : 65536;
+
   /**
    * Returns the position of the page with the given number in the file (as an
-   * offset from the beginning of the file).
+   * offset from the beginning of the file).  Direct-layout files pad the
+   * file header out to a full block so every page starts block-aligned.
    *
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  off_t pagePosition(const PageId page_number) const {
+    const off_t header_bytes =
+        state_->directLayout ? (off_t)DIRECT_BLOCK : (off_t)sizeof(FileHeader);
+    return header_bytes + ((off_t)(page_number - 1) * Page::SIZE);
   }
 
   /**
@@ -214,33 +441,104 @@ class File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct      Whether to use direct I/O and the aligned layout.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new,
+       const bool direct = false);
 
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
    *
    * @param create_new  Whether to create a new file.
+   * @param direct      Whether to use direct I/O and the aligned layout.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  void openIfNeeded(const bool create_new);
+  void openIfNeeded(const bool create_new, const bool direct = false);
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Closes the underlying file descriptor in <fd_>.
    * This method only closes the file if no other File objects exist that access
    * the same file.
    */
   void close();
 
+  /**
+   * Reads exactly <count> bytes at the given offset into <buffer>, looping
+   * over short reads and interrupted syscalls.  Bytes past the end of the
+   * file are zero-filled.
+   *
+   * @param buffer  Destination buffer.
+   * @param count   Number of bytes to read.
+   * @param offset  Offset in the file to read from.
+   * @throws  FileIoException  If the read fails with a hard error.
+   */
+  void read(void* buffer, const std::size_t count, const off_t offset) const;
+
+  /**
+   * Writes exactly <count> bytes from <buffer> at the given offset, looping
+   * over short writes and interrupted syscalls.
+   *
+   * @param buffer  Source buffer.
+   * @param count   Number of bytes to write.
+   * @param offset  Offset in the file to write at.
+   * @throws  FileIoException  If the write fails with a hard error, so no
+   *                           byte is ever silently dropped.
+   */
+  void write(const void* buffer, const std::size_t count, const off_t offset);
+
+  /**
+   * Writes all the buffers described by <iov> at the given offset in one
+   * stream, looping over short writes.
+   *
+   * @param iov     Buffers to write; adjusted in place on short writes.
+   * @param count   Number of buffers.
+   * @param offset  Offset in the file to write at.
+   * @throws  FileIoException  If the write fails with a hard error.
+   */
+  void writeVectored(struct iovec* iov, int count, off_t offset);
+
+  /**
+   * Returns this thread's DIRECT_CHUNK-sized, DIRECT_BLOCK-aligned bounce
+   * buffer, allocating it on first use.
+   */
+  static char* directBounce();
+
+  /**
+   * Direct-mode counterpart of read(): transfers through the aligned
+   * bounce buffer so arbitrary offsets and lengths work over O_DIRECT.
+   * Bytes past the end of the file are zero-filled.
+   *
+   * @param buffer  Destination buffer.
+   * @param count   Number of bytes to read.
+   * @param offset  Offset in the file to read from.
+   * @throws  FileIoException  If a transfer fails with a hard error.
+   */
+  void directRead(void* buffer, const std::size_t count,
+                  const off_t offset) const;
+
+  /**
+   * Direct-mode counterpart of write().  Partial blocks at the edges of
+   * the range are read back first and merged, so unaligned writes stay
+   * exact.  Concurrent writers must not share a block; the aligned layout
+   * guarantees this for writes to distinct pages.
+   *
+   * @param buffer  Source buffer.
+   * @param count   Number of bytes to write.
+   * @param offset  Offset in the file to write at.
+   * @throws  FileIoException  If a transfer fails with a hard error.
+   */
+  void directWrite(const void* buffer, const std::size_t count,
+                   const off_t offset);
+
   /**
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
@@ -256,6 +554,23 @@ class File {
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
+  /**
+   * Reads a page from the file into the given Page object.  If <allow_free>
+   * is not set, an exception will be thrown if the page read from disk is
+   * not currently in use.
+   *
+   * No bounds checking is performed; the underlying file stream will throw
+   * an exception if the page is past the end of the file.
+   *
+   * @param page_number   Number of page to read.
+   * @param allow_free    Whether to allow reading a free (unused) page.
+   * @param page          Page object to read into.
+   * @throws  InvalidPageException  If the page is free (unused) and
+   *                                allow_free is false.
+   */
+  void readPage(const PageId page_number, const bool allow_free,
+                Page& page) const;
+
   /**
    * Writes a page into the file at the given page number.  This does not
    * update ensure that the number in the header equals the position on disk.
@@ -301,19 +616,287 @@ class File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
-  typedef std::map<std::string,
-                   std::shared_ptr<std::fstream> > StreamMap;
-  typedef std::map<std::string, int> CountMap;
+  /**
+   * Verifies the page's stored data checksum according to the current
+   * checksum mode: inline (throwing on mismatch), queued on the I/O
+   * engine against a snapshot of the page (counting mismatches), or not
+   * at all.
+   *
+   * @param page          Page as read from disk.
+   * @param page_number   Number of the page, for diagnostics.
+   * @throws  PageChecksumException  On a mismatch in CHECKSUM_SYNC mode.
+   */
+  void verifyChecksum(const Page& page, const PageId page_number) const;
+
+  /**
+   * Process-wide checksum verification mode.
+   */
+  static std::atomic<int> checksum_mode_;
+
+  /**
+   * Mismatches detected by deferred verification.
+   */
+  static std::atomic<std::uint64_t> checksum_failures_;
+
+  /**
+   * @brief State shared between all File objects for one underlying file.
+   *
+   * Besides the descriptor, this holds the cached file header and a cache
+   * of page headers so that page reads and writes do not pay an extra
+   * header I/O round-trip each.  Cached entries are updated on every
+   * write-through, so they always match the bytes on disk.
+   */
+  struct OpenFileState {
+    /**
+     * Descriptor for underlying filesystem object.
+     */
+    int fd;
+
+    /**
+     * Number of File objects sharing this state; the descriptor closes
+     * when it drops to zero.
+     */
+    int refcount;
+
+    /**
+     * Shared read-only mapping of the file, or NULL when not mapped.
+     */
+    void* map;
+
+    /**
+     * Size of the mapping in bytes.
+     */
+    std::size_t mapBytes;
+
+    /**
+     * Whether this file was opened in mmap-backed mode.
+     */
+    bool mapped;
+
+    /**
+     * Whether the descriptor was opened with O_DIRECT, routing page I/O
+     * around the OS page cache through aligned transfers.
+     */
+    bool directIo;
+
+    /**
+     * Whether the file uses the block-aligned direct layout (padded file
+     * header, block-aligned pages).  Stays set even when the O_DIRECT
+     * open itself had to fall back to buffered I/O.
+     */
+    bool directLayout;
+
+    /**
+     * Cached copy of the on-disk file header; valid once read or written.
+     */
+    FileHeader header;
+
+    /**
+     * Whether <header> holds the current on-disk file header.
+     */
+    bool headerValid;
+
+    /**
+     * Cached page headers, keyed by page number.  Bounded; cleared
+     * wholesale if it grows past PAGE_HEADER_CACHE_MAX entries.
+     */
+    std::unordered_map<PageId, PageHeader> pageHeaders;
+
+    /**
+     * Cached tail of the used-page list (INVALID_NUMBER when the list is
+     * empty), so allocation can append without walking the list.
+     */
+    PageId lastUsedPage;
+
+    /**
+     * Whether <lastUsedPage> is known; computed lazily on first allocation.
+     */
+    bool lastUsedValid;
+
+    /**
+     * Cached predecessor map for the used-page list: prevPage[n] is the
+     * page whose next pointer is n.  The list head has no entry.  Primed
+     * with one walk of the page-header chain and maintained on every
+     * allocation and deletion, so deletePage() finds the page to patch
+     * without walking the list.
+     */
+    std::unordered_map<PageId, PageId> prevPage;
+
+    /**
+     * Whether <prevPage> describes the current used list; computed lazily
+     * on first deletion.
+     */
+    bool prevValid;
+
+    /**
+     * Free-space buckets: spaceBuckets[b] holds the used pages whose
+     * reusable space (free bytes plus dead space) falls in bucket b, and
+     * pageBucket maps each page back to its bucket.  Primed with one walk
+     * of the page-header chain and maintained by cachePageHeader() as
+     * headers are written, so findPageWithSpace() answers without any
+     * page reads.
+     */
+    std::vector<std::unordered_set<PageId> > spaceBuckets;
+
+    /**
+     * Inverse of <spaceBuckets>: the bucket each mapped page is filed in.
+     */
+    std::unordered_map<PageId, std::uint8_t> pageBucket;
+
+    /**
+     * Whether the free-space buckets describe the current file; computed
+     * lazily on the first findPageWithSpace() call.
+     */
+    bool spaceValid;
+
+    /**
+     * Guards the cached headers (the descriptor itself needs no latch as
+     * all I/O on it is positional).
+     */
+    std::mutex latch;
+  };
+
+  /**
+   * Upper bound on cached page headers per file.
+   */
+  static const std::size_t PAGE_HEADER_CACHE_MAX = 65536;
+
+  /**
+   * Number of free-space buckets per file; reusable space maps onto them
+   * linearly over [0, Page::DATA_SIZE].
+   */
+  static const std::size_t SPACE_BUCKETS = 16;
+
+  /**
+   * Returns the free-space bucket for the given amount of reusable space.
+   *
+   * @param bytes  Reusable bytes on the page.
+   * @return  The bucket index, in [0, SPACE_BUCKETS).
+   */
+  static std::uint8_t spaceBucketOf(const std::size_t bytes) {
+    return (std::uint8_t)(bytes * SPACE_BUCKETS / (Page::DATA_SIZE + 1));
+  }
+
+  /**
+   * Files the page under the free-space bucket for <reusable> bytes, or
+   * drops it from the map when the page is free.  Caller must hold the
+   * state latch; a no-op until the buckets have been primed.
+   *
+   * @param page_number  Number of the page.
+   * @param header       The page's current header.
+   */
+  void spaceMapUpdate(const PageId page_number,
+                      const PageHeader& header) const;
+
+  /**
+   * Answers findPageWithSpace() from the primed buckets.  Caller must
+   * hold the state latch.
+   *
+   * @param needed  Reusable bytes the page must offer.
+   * @return  Number of a page guaranteed to fit, or Page::INVALID_NUMBER.
+   */
+  PageId spaceLookupLocked(const std::size_t needed) const;
+
+  typedef std::map<std::string, FileId> InternMap;
+
+  /**
+   * Filename-to-id intern table.  Probed once when a File object is
+   * constructed; every lookup after that indexes by id.  Ids are never
+   * recycled, so a name keeps its id for the life of the process.
+   */
+  static InternMap file_ids_;
+
+  /**
+   * Shared state for opened files, indexed by FileId.  Closed files leave
+   * an empty slot behind.
+   */
+  static std::vector<std::shared_ptr<OpenFileState> > states_by_id_;
+
+  /**
+   * Guards the intern table, the per-id state slots and the refcounts, so
+   * concurrent open/copy/close of File objects for one underlying file
+   * cannot race to a double-close or a leaked descriptor.
+   */
+  static std::mutex registry_latch_;
+
+  /**
+   * Interns a filename, assigning the next dense id on first sight.
+   * Caller must hold the registry latch.
+   *
+   * @param filename  Name of the file.
+   * @return  The file's id.
+   */
+  static FileId internFilename(const std::string& filename);
+
+  /**
+   * Establishes the shared mapping on first use.
+   */
+  void ensureMapped();
+
+  /**
+   * (Re)maps the file at its current size.  Caller must hold the state
+   * latch.
+   *
+   * @throws  FileNotFoundException  If the mapping cannot be established.
+   */
+  void remapLocked() const;
+
+  /**
+   * Caches the header of the given page.  Caller must hold the state latch.
+   *
+   * @param page_number Number of page the header belongs to.
+   * @param header      Header to cache.
+   */
+  void cachePageHeader(const PageId page_number,
+                       const PageHeader& header) const;
+
+  /**
+   * Returns the tail of the used-page list, walking the page-header chain
+   * once to prime the cached tail pointer if it isn't known yet.
+   *
+   * @param header  Current file header.
+   * @return  Page number of the last used page, or Page::INVALID_NUMBER.
+   */
+  PageId usedListTail(const FileHeader& header) const;
 
   /**
-   * Streams for opened files.
+   * Records the given page as the tail of the used-page list.
+   *
+   * @param page_number Number of new tail page.
    */
-  static StreamMap open_streams_;
+  void setUsedListTail(const PageId page_number);
 
   /**
-   * Counts for opened files.
+   * Returns the predecessor of the given page in the used-page list, or
+   * Page::INVALID_NUMBER if it is the head, priming the predecessor map
+   * with one walk of the page-header chain if it isn't valid yet.
+   *
+   * @param page_number Number of page whose predecessor to look up.
+   * @param header      Current file header.
+   * @return  Page number of the predecessor, or Page::INVALID_NUMBER.
    */
-  static CountMap open_counts_;
+  PageId usedListPredecessor(const PageId page_number,
+                             const FileHeader& header);
+
+  /**
+   * Unlinks and frees one page, updating <header> in place but not
+   * writing it back; shared by deletePage() and deletePages().
+   *
+   * @param page_number Number of page to delete.
+   * @param header      File header, updated in place.
+   * @throws  InvalidPageException  If the page doesn't exist in the file
+   *                                or is not currently used.
+   */
+  void deletePageInternal(const PageId page_number, FileHeader& header);
+
+  /**
+   * Rewrites just the header of the given page so its next-page pointer is
+   * <next>, leaving the page data untouched.
+   *
+   * @param page_number Number of page whose header to patch.
+   * @param next        New next page number.
+   */
+  void patchNextPointer(const PageId page_number, const PageId next);
 
   /**
    * Name of the file this object represents.
@@ -321,11 +904,23 @@ class File {
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Dense id interned for filename_.
    */
-  std::shared_ptr<std::fstream> stream_;
+  FileId id_;
+
+  /**
+   * State of the underlying filesystem object, shared between all File
+   * objects for the same filename.
+   */
+  std::shared_ptr<OpenFileState> state_;
 
   friend class FileIterator;
+
+  // Streams pages through a private frame ring for pool-bypassing scans.
+  friend class BulkScan;
+
+  // Follows the used-page chain with a window of asynchronous readahead.
+  friend class FileScanner;
   friend class FileTest;
 };
 
@@ -0,0 +1,66 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "file_scanner.h"
+
+namespace badgerdb {
+
+const std::uint32_t FileScanner::NO_SLOT;
+
+FileScanner::FileScanner(File* fileIn, const std::uint32_t windowIn)
+    : file(fileIn), window(windowIn),
+      pending(windowIn), slotBusy(windowIn, false),
+      cursor(0), deliveredSlot(NO_SLOT) {
+  ring = new Page[window];
+  nextInChain = file->readHeader().first_used_page;
+  for (std::uint32_t slot = 0; slot < window; slot++) {
+    issueNext(slot);
+  }
+}
+
+FileScanner::~FileScanner() {
+  // drain in-flight reads so the engine stops touching the ring
+  for (std::uint32_t slot = 0; slot < window; slot++) {
+    if (slotBusy[slot]) {
+      pending[slot].get();
+    }
+  }
+  delete [] ring;
+}
+
+void FileScanner::issueNext(const std::uint32_t slot) {
+  if (nextInChain == Page::INVALID_NUMBER) {
+    return;
+  }
+  const PageId page_number = nextInChain;
+  // Hop the chain forward through a header-sized read (usually a header
+  // cache hit) before the full page arrives, so the window stays full.
+  nextInChain = file->readPageHeader(page_number).next_page_number;
+  pending[slot] = file->readPageAsync(page_number, ring[slot]);
+  slotBusy[slot] = true;
+}
+
+const Page* FileScanner::next() {
+  // the slot handed out last time is free again; refill it
+  if (deliveredSlot != NO_SLOT) {
+    issueNext(deliveredSlot);
+    deliveredSlot = NO_SLOT;
+  }
+
+  const std::uint32_t slot = cursor;
+  if (!slotBusy[slot]) {
+    return NULL; // ring drained: end of chain
+  }
+  cursor = (cursor + 1) % window;
+  slotBusy[slot] = false;
+  pending[slot].get();
+
+  deliveredSlot = slot;
+  return &ring[slot];
+}
+
+}
@@ -0,0 +1,112 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <future>
+#include <vector>
+
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Readahead-driven scan over the used pages of a file.
+ *
+ * FileIterator fetches one page per step, so every advance of a
+ * sequential scan is a blocking synchronous read.  A FileScanner follows
+ * the same next_page_number chain but keeps a window's worth of full-page
+ * reads in flight on the I/O engine: the chain itself is discovered ahead
+ * of time through header-sized reads (usually served from the per-file
+ * header cache), and the page data streams asynchronously into a private
+ * ring of frames.  Pages are delivered in used-list order, matching
+ * FileIterator; the pointer returned by next() stays valid until the
+ * following next() call.
+ */
+class FileScanner {
+ public:
+  /**
+   * Starts a scan at the first used page of the file.
+   *
+   * @param fileIn    File to scan.
+   * @param windowIn  Number of page reads kept in flight (and ring size).
+   */
+  FileScanner(File* fileIn, const std::uint32_t windowIn = 16);
+
+  /**
+   * Drains any in-flight readahead and releases the ring.
+   */
+  ~FileScanner();
+
+  /**
+   * Returns the next used page of the file, or NULL when the scan is
+   * complete.  The returned page lives in the ring and is overwritten by
+   * a later call.
+   */
+  const Page* next();
+
+ private:
+  /**
+   * Sentinel for deliveredSlot when no page is currently handed out.
+   */
+  static const std::uint32_t NO_SLOT = 0xFFFFFFFF;
+
+  /**
+   * Issues the next page of the chain into the given ring slot, if any
+   * pages remain, advancing the chain cursor via a header read.
+   *
+   * @param slot  Ring slot to read into.
+   */
+  void issueNext(const std::uint32_t slot);
+
+  /**
+   * File being scanned.
+   */
+  File* file;
+
+  /**
+   * Number of frames in the ring (readahead depth).
+   */
+  std::uint32_t window;
+
+  /**
+   * The private frames pages stream through.
+   */
+  Page* ring;
+
+  /**
+   * Completion token of the read in flight for each slot.
+   */
+  std::vector<std::future<void> > pending;
+
+  /**
+   * Whether each slot has a read in flight.
+   */
+  std::vector<bool> slotBusy;
+
+  /**
+   * Next page number in the used-list chain to issue readahead for.
+   */
+  PageId nextInChain;
+
+  /**
+   * Ring slot the next page will be delivered from.
+   */
+  std::uint32_t cursor;
+
+  /**
+   * Slot handed out by the previous next() call, recycled on the next one.
+   */
+  std::uint32_t deliveredSlot;
+
+  FileScanner(const FileScanner&);            // ring frames are not shareable
+  FileScanner& operator=(const FileScanner&); // ring frames are not shareable
+};
+
+}
@@ -0,0 +1,71 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "ioEngine.h"
+
+namespace badgerdb {
+
+IoEngine& IoEngine::instance() {
+  static IoEngine engine;
+  return engine;
+}
+
+IoEngine::IoEngine()
+    : stopping_(false) {
+  for (int i = 0; i < NUM_WORKERS; i++) {
+    workers_.push_back(std::thread(&IoEngine::workerMain, this));
+  }
+}
+
+IoEngine::~IoEngine() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    cv_.notify_all();
+  }
+  for (std::size_t i = 0; i < workers_.size(); i++) {
+    workers_[i].join();
+  }
+}
+
+std::future<void> IoEngine::submit(std::function<void()> operation) {
+  Task task;
+  task.operation = operation;
+  task.done.reset(new std::promise<void>());
+  std::future<void> token = task.done->get_future();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  queue_.push_back(task);
+  cv_.notify_one();
+  return token;
+}
+
+void IoEngine::workerMain() {
+  while (true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (!stopping_ && queue_.empty()) {
+        cv_.wait(lock);
+      }
+      if (queue_.empty()) {
+        return; // stopping and fully drained
+      }
+      task = queue_.front();
+      queue_.pop_front();
+    }
+
+    try {
+      task.operation();
+      task.done->set_value();
+    } catch (...) {
+      task.done->set_exception(std::current_exception());
+    }
+  }
+}
+
+}
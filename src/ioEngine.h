@@ -0,0 +1,116 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+ * @brief Asynchronous I/O engine servicing queued page operations.
+ *
+ * Callers (File::readPageAsync/writePageAsync and BufMgr features built on
+ * them) enqueue page-sized operations and get a completion token back, so
+ * dozens of reads and writes can be in flight at once instead of one
+ * blocking syscall per page. The current implementation drains the queue
+ * with a small pool of worker threads issuing pread/pwrite; the submission
+ * and completion interface is deliberately queue-shaped so a kernel
+ * submission-queue backend (io_uring) can replace the workers without
+ * changing callers.
+ */
+class IoEngine {
+ public:
+  /**
+   * Returns the process-wide engine, started on first use.
+   *
+   * @return  The engine.
+   */
+  static IoEngine& instance();
+
+  /**
+   * Queues an operation for execution on the engine.  The returned future
+   * becomes ready when the operation completes; an exception thrown by the
+   * operation is rethrown from the future.
+   *
+   * @param operation   Operation to run.
+   * @return  Completion token for the operation.
+   */
+  std::future<void> submit(std::function<void()> operation);
+
+  /**
+   * Stops the workers after draining the queue.
+   */
+  ~IoEngine();
+
+ private:
+  /**
+   * Number of worker threads draining the submission queue.
+   */
+  static const int NUM_WORKERS = 4;
+
+  /**
+   * @brief One queued operation and its completion promise.
+   */
+  struct Task {
+    /**
+     * The operation to run.
+     */
+    std::function<void()> operation;
+
+    /**
+     * Fulfilled (or failed) when the operation finishes.
+     */
+    std::shared_ptr<std::promise<void> > done;
+  };
+
+  /**
+   * Starts the worker threads.
+   */
+  IoEngine();
+
+  IoEngine(const IoEngine&);            // not copyable
+  IoEngine& operator=(const IoEngine&); // not assignable
+
+  /**
+   * Main loop of a worker thread.
+   */
+  void workerMain();
+
+  /**
+   * Pending operations.
+   */
+  std::deque<Task> queue_;
+
+  /**
+   * Worker threads.
+   */
+  std::vector<std::thread> workers_;
+
+  /**
+   * Guards the queue.
+   */
+  std::mutex mutex_;
+
+  /**
+   * Wakes workers when operations are queued.
+   */
+  std::condition_variable cv_;
+
+  /**
+   * Set when the engine is shutting down.
+   */
+  bool stopping_;
+};
+
+}
@@ -56,6 +56,10 @@ void test6();
 void testBufMgr();
 void test7();
 void test8();
+void test9();
+void test10();
+void test11();
+void test12();
 
 int main() 
 {
@@ -169,6 +173,10 @@ void testBufMgr()
 	test6();
 	test7();
 	test8();
+	test9();
+	test10();
+	test11();
+	test12();
 
 	//Close files before deleting them
 	file1.~File();
@@ -388,4 +396,259 @@ void test8()
 		}
 	}
 	std::cout<< "Test 8 passed" << "\n";
+}
+
+void test9()
+{
+	//Victim cache codec round-trips on crafted page contents
+	VictimCache cache;
+	cache.setCapacity(1024 * 1024);
+
+	// Compressible: repeated text compresses and must round-trip exactly
+	Page compressible;
+	RecordId crid = compressible.insertRecord("abcdabcdabcdabcdabcdabcdabcdabcd");
+	cache.put(1, 1, compressible);
+	Page out;
+	if (!cache.get(1, 1, out))
+	{
+		PRINT_ERROR("ERROR :: Compressible page should have been stored in the victim cache.");
+	}
+	if (out.getRecord(crid) != compressible.getRecord(crid))
+	{
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH AFTER DECOMPRESSION");
+	}
+
+	// Entries are removed on hit; a second get must miss
+	if (cache.get(1, 1, out))
+	{
+		PRINT_ERROR("ERROR :: Victim cache hits should remove the entry.");
+	}
+
+	// Run-length style: long single-byte runs exercise overlapping matches
+	Page runs;
+	RecordId rrid = runs.insertRecord(std::string(2000, 'x') + std::string(2000, 'y'));
+	cache.put(1, 2, runs);
+	if (!cache.get(1, 2, out) || out.getRecord(rrid) != runs.getRecord(rrid))
+	{
+		PRINT_ERROR("ERROR :: Run-length page did not round-trip through the victim cache.");
+	}
+
+	// Incompressible: fill a page with pseudo-random bytes; the cache
+	// must decline to store it rather than hold it raw
+	Page noise;
+	std::uint32_t seed = 12345;
+	// one page-filling random record: no zero gap and no slot-array
+	// stride left for the codec to win back
+	std::string bytes(noise.getFreeSpace() - sizeof(PageSlot), '\0');
+	for (std::size_t b = 0; b < bytes.size(); b++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		bytes[b] = (char)(1 + (seed >> 24) % 255);
+	}
+	noise.insertRecord(bytes);
+	cache.put(1, 3, noise);
+	if (cache.get(1, 3, out))
+	{
+		PRINT_ERROR("ERROR :: Incompressible page should have been skipped by the victim cache.");
+	}
+
+	std::cout << "Test 9 passed" << "\n";
+}
+
+void test10()
+{
+	//Evicted pages must come back out of the victim cache instead of disk
+	bufMgr->setVictimCacheBytes(4 * 1024 * 1024);
+
+	PageId vcpid[num + num/2];
+	RecordId vcrid[num + num/2];
+	for (i = 0; i < num + num/2; i++)
+	{
+		bufMgr->allocPage(file2ptr, vcpid[i], page);
+		sprintf((char*)tmpbuf, "test.2 victim %u", vcpid[i]);
+		vcrid[i] = page->insertRecord(tmpbuf);
+		bufMgr->unPinPage(file2ptr, vcpid[i], true);
+	}
+
+	// The pool holds <num> frames, so the early pages were evicted into
+	// the cache; reading them back must hit it and return the contents
+	for (i = 0; i < num/2; i++)
+	{
+		bufMgr->readPage(file2ptr, vcpid[i], page);
+		sprintf((char*)tmpbuf, "test.2 victim %u", vcpid[i]);
+		if(strncmp(page->getRecord(vcrid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH AFTER VICTIM CACHE HIT");
+		}
+		bufMgr->unPinPage(file2ptr, vcpid[i], false);
+	}
+
+	std::uint64_t hits, stores, evictions;
+	bufMgr->getVictimCacheStats(hits, stores, evictions);
+	if (hits == 0)
+	{
+		PRINT_ERROR("ERROR :: Re-reading evicted pages should have hit the victim cache.");
+	}
+
+	bufMgr->setVictimCacheBytes(0);
+	bufMgr->flushFile(file2ptr);
+	std::cout << "Test 10 passed" << "\n";
+}
+
+void test11()
+{
+	//deleteRecord/compact: reclaimed space is reusable and surviving
+	//records keep their contents and record IDs
+	const std::size_t recSize = Page::DEAD_SPACE_THRESHOLD - 200;
+
+	Page full;
+	RecordId ids[8];
+	for (i = 0; i < 8; i++)
+	{
+		ids[i] = full.insertRecord(std::string(recSize, (char)('a' + i)));
+	}
+	full.insertRecord(std::string(full.getFreeSpace() - sizeof(PageSlot), 'z'));
+
+	// Delete a middle record: below the threshold, so the space is only
+	// marked dead and the contiguous gap stays too small for a reinsert
+	full.deleteRecord(ids[2]);
+	if (full.getFreeSpace() >= recSize)
+	{
+		PRINT_ERROR("ERROR :: A below-threshold delete should not have compacted the page.");
+	}
+
+	// Reinserting a record of the deleted size forces the insert path to
+	// compact and reclaim the dead space
+	RecordId reborn = full.insertRecord(std::string(recSize, 'R'));
+	if (full.getRecord(reborn) != std::string(recSize, 'R'))
+	{
+		PRINT_ERROR("ERROR :: Reinserted record did not land in the reclaimed space intact.");
+	}
+
+	// Two more deletes push dead space past DEAD_SPACE_THRESHOLD; the
+	// second one must compact in place
+	full.deleteRecord(ids[4]);
+	full.deleteRecord(ids[5]);
+	if (full.getFreeSpace() < 2 * recSize)
+	{
+		PRINT_ERROR("ERROR :: Threshold-crossing deletes should have compacted the dead space away.");
+	}
+	const SlotId survivors[] = { 0, 1, 3, 6, 7 };
+	for (i = 0; i < 5; i++)
+	{
+		const SlotId s = survivors[i];
+		if (full.getRecord(ids[s]) != std::string(recSize, (char)('a' + s)))
+		{
+			PRINT_ERROR("ERROR :: A surviving record was damaged by compaction.");
+		}
+	}
+
+	// Update larger than the contiguous gap but smaller than gap plus
+	// dead space: must compact rather than fail
+	Page upd;
+	RecordId doomed = upd.insertRecord(std::string(400, 'a'));
+	RecordId target = upd.insertRecord(std::string(400, 'b'));
+	RecordId keeper = upd.insertRecord(std::string(upd.getFreeSpace() - sizeof(PageSlot) - 300, 'c'));
+	upd.deleteRecord(doomed);
+	if (upd.getFreeSpace() >= 600)
+	{
+		PRINT_ERROR("ERROR :: The contiguous gap should be smaller than the updated record.");
+	}
+	upd.updateRecord(target, std::string(600, 'B'));
+	if (upd.getRecord(target) != std::string(600, 'B'))
+	{
+		PRINT_ERROR("ERROR :: Updated record did not survive the compacting update.");
+	}
+	if (upd.getRecord(keeper).at(0) != 'c')
+	{
+		PRINT_ERROR("ERROR :: Unrelated record was damaged by the compacting update.");
+	}
+
+	std::cout << "Test 11 passed" << "\n";
+}
+
+void test12()
+{
+	//File::findPageWithSpace steers inserts by the free-space map
+	const std::string fsmname = "test.fsm";
+	if (File::exists(fsmname))
+	{
+		File::remove(fsmname);
+	}
+	{
+		File fsmfile = File::create(fsmname);
+
+		// Page 1: nearly full.  Page 2: half full.  Page 3: empty.
+		Page full = fsmfile.allocatePage();
+		while (full.getFreeSpace() > 200)
+		{
+			full.insertRecord(std::string(100, 'a'));
+		}
+		fsmfile.writePage(full);
+
+		Page half = fsmfile.allocatePage();
+		while (half.getFreeSpace() > Page::DATA_SIZE / 2)
+		{
+			half.insertRecord(std::string(100, 'b'));
+		}
+		fsmfile.writePage(half);
+
+		Page empty = fsmfile.allocatePage();
+		fsmfile.writePage(empty);
+
+		// A small record fits somewhere, and the page handed back must
+		// really have room for it
+		PageId target = fsmfile.findPageWithSpace(100);
+		if (target == Page::INVALID_NUMBER)
+		{
+			PRINT_ERROR("ERROR :: The free-space map found no page for a small record.");
+		}
+		Page landing = fsmfile.readPage(target);
+		if (!landing.hasSpaceForRecord(std::string(100, 'c')))
+		{
+			PRINT_ERROR("ERROR :: The page returned by the free-space map cannot hold the record.");
+		}
+
+		// A near-page-sized record only fits on the empty page
+		const std::size_t big = Page::DATA_SIZE - 100;
+		if (fsmfile.findPageWithSpace(big) != empty.page_number())
+		{
+			PRINT_ERROR("ERROR :: A near-page-sized record should only match the empty page.");
+		}
+
+		// Fill the empty page; the map must follow the header write
+		while (empty.getFreeSpace() > 200)
+		{
+			empty.insertRecord(std::string(100, 'd'));
+		}
+		fsmfile.writePage(empty);
+		if (fsmfile.findPageWithSpace(big) != Page::INVALID_NUMBER)
+		{
+			PRINT_ERROR("ERROR :: The free-space map did not track the filled page.");
+		}
+
+		// Deleting a page drops it from the map: with the half-full page
+		// gone, nothing fits a half-page record any more
+		fsmfile.deletePage(half.page_number());
+		if (fsmfile.findPageWithSpace(Page::DATA_SIZE / 2 - 100) != Page::INVALID_NUMBER)
+		{
+			PRINT_ERROR("ERROR :: A deleted page should drop out of the free-space map.");
+		}
+
+		// Records longer than a page never match
+		if (fsmfile.findPageWithSpace(Page::DATA_SIZE) != Page::INVALID_NUMBER)
+		{
+			PRINT_ERROR("ERROR :: No page can hold a record larger than the data area.");
+		}
+
+		// A freshly allocated page shows up immediately
+		Page fresh = fsmfile.allocatePage();
+		if (fsmfile.findPageWithSpace(big) != fresh.page_number())
+		{
+			PRINT_ERROR("ERROR :: A freshly allocated page should show up in the free-space map.");
+		}
+	}
+	File::remove(fsmname);
+
+	std::cout << "Test 12 passed" << "\n";
 }
\ No newline at end of file
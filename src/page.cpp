@@ -5,7 +5,10 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <vector>
 
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_record_exception.h"
@@ -16,6 +19,24 @@
 
 namespace badgerdb {
 
+namespace {
+
+// The slot array is scanned 4 slots (= 24 bytes = 3 words, since
+// sizeof(PageSlot) is 6) per step.  These masks pick out the four used
+// flags, which land at chunk byte offsets 0, 6, 12 and 18.
+static_assert(sizeof(PageSlot) == 6, "slot scan chunking assumes 6-byte slots");
+
+const std::uint64_t kUsedMaskWord0 = 0x00FF0000000000FFULL; // slots +0, +1
+const std::uint64_t kUsedMaskWord1 = 0x000000FF00000000ULL; // slot +2
+const std::uint64_t kUsedMaskWord2 = 0x0000000000FF0000ULL; // slot +3
+
+// The same positions when every flag holds the value true (0x01).
+const std::uint64_t kAllUsedWord0 = 0x0001000000000001ULL;
+const std::uint64_t kAllUsedWord1 = 0x0000000100000000ULL;
+const std::uint64_t kAllUsedWord2 = 0x0000000000010000ULL;
+
+}
+
 Page::Page() {
   initialize();
 }
@@ -27,23 +48,58 @@ void Page::initialize() {
   header_.num_free_slots = 0;
   header_.current_page_number = INVALID_NUMBER;
   header_.next_page_number = INVALID_NUMBER;
-  data_.assign(DATA_SIZE, char());
+  header_.first_free_slot_hint = 1;
+  header_.dead_space = 0;
+  header_.checksum = 0;
+  std::memset(data_, 0, DATA_SIZE);
 }
 
 RecordId Page::insertRecord(const std::string& record_data) {
-  if (!hasSpaceForRecord(record_data)) {
-    throw InsufficientSpaceException(
-        page_number(), record_data.length(), getFreeSpace());
+  return insertRecord(record_data.data(), (std::uint16_t)record_data.length());
+}
+
+RecordId Page::insertRecord(const char* record_data,
+                            const std::uint16_t length) {
+  RecordId record_id;
+  insertRecordInternal(record_data, length, record_id);
+  return record_id;
+}
+
+char* Page::reserveRecord(const std::uint16_t length, RecordId& record_id) {
+  return insertRecordInternal(NULL /* record_data */, length, record_id);
+}
+
+char* Page::insertRecordInternal(const char* record_data,
+                                 const std::uint16_t length,
+                                 RecordId& record_id) {
+  std::size_t record_size = length;
+  if (header_.num_free_slots == 0) {
+    record_size += sizeof(PageSlot);
+  }
+  if (record_size > getFreeSpace()) {
+    if (record_size > getFreeSpace() + header_.dead_space) {
+      throw InsufficientSpaceException(page_number(), length,
+                                       getFreeSpace() + header_.dead_space);
+    }
+    // the contiguous gap is too small but reclaiming dead space makes room
+    compact();
   }
   const SlotId slot_number = getAvailableSlot();
-  insertRecordInSlot(slot_number, record_data);
-  return {page_number(), slot_number};
+  char* destination = insertRecordInSlot(slot_number, record_data, length);
+  record_id = {page_number(), slot_number};
+  return destination;
 }
 
 std::string Page::getRecord(const RecordId& record_id) const {
   validateRecordId(record_id);
   const PageSlot& slot = getSlot(record_id.slot_number);
-  return data_.substr(slot.item_offset, slot.item_length);
+  return std::string(&data_[slot.item_offset], slot.item_length);
+}
+
+RecordView Page::getRecordView(const RecordId& record_id) const {
+  validateRecordId(record_id);
+  const PageSlot& slot = getSlot(record_id.slot_number);
+  return {&data_[slot.item_offset], slot.item_length};
 }
 
 void Page::updateRecord(const RecordId& record_id,
@@ -51,7 +107,7 @@ void Page::updateRecord(const RecordId& record_id,
   validateRecordId(record_id);
   const PageSlot* slot = getSlot(record_id.slot_number);
   const std::size_t free_space_after_delete =
-      getFreeSpace() + slot->item_length;
+      getFreeSpace() + header_.dead_space + slot->item_length;
   if (record_data.length() > free_space_after_delete) {
     throw InsufficientSpaceException(
         page_number(), record_data.length(), free_space_after_delete);
@@ -60,6 +116,10 @@ void Page::updateRecord(const RecordId& record_id,
   // record data in the same slot, and compaction might delete the slot if we
   // permit it.
   deleteRecord(record_id, false /* allow_slot_compaction */);
+  if (record_data.length() > getFreeSpace()) {
+    // the old version's bytes are still in place; reclaim them first
+    compact();
+  }
   insertRecordInSlot(record_id.slot_number, record_data);
 }
 
@@ -71,35 +131,30 @@ void Page::deleteRecord(const RecordId& record_id,
                         const bool allow_slot_compaction) {
   validateRecordId(record_id);
   PageSlot* slot = getSlot(record_id.slot_number);
-  data_.replace(slot->item_offset, slot->item_length, slot->item_length, '\0');
 
-  // Compact the data by removing the hole left by this record (if necessary).
-  std::uint16_t move_offset = slot->item_offset; 
-  std::size_t move_bytes = 0;
-  for (SlotId i = 1; i <= header_.num_slots; ++i) {
-    PageSlot* other_slot = getSlot(i);
-    if (other_slot->used && other_slot->item_offset < slot->item_offset) {
-      if (other_slot->item_offset < move_offset) {
-        move_offset = other_slot->item_offset;
-      }
-      move_bytes += other_slot->item_length;
-      // Update the slot for the other data to reflect the soon-to-be-new
-      // location.
-      other_slot->item_offset += slot->item_length;
-    }
-  }
-  // If we have data to move, shift it to the right.
-  if (move_bytes > 0) {
-    const std::string& data_to_move = data_.substr(move_offset, move_bytes);
-    data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
+  // Deletes are lazy: the record's bytes stay where they are and are only
+  // reclaimed when compact() runs, so a delete is O(1) instead of shuffling
+  // the rest of the data area.
+  if (slot->item_offset == header_.free_space_upper_bound) {
+    // Deleting the record bordering the free space needs no compaction to
+    // reclaim its bytes.
+    header_.free_space_upper_bound += slot->item_length;
+  } else {
+    header_.dead_space += slot->item_length;
   }
-  header_.free_space_upper_bound += slot->item_length;
 
   // Mark slot as unused.
   slot->used = false;
   slot->item_offset = 0;
   slot->item_length = 0;
   ++header_.num_free_slots;
+  if (record_id.slot_number < header_.first_free_slot_hint) {
+    header_.first_free_slot_hint = record_id.slot_number;
+  }
+
+  if (header_.dead_space >= DEAD_SPACE_THRESHOLD) {
+    compact();
+  }
 
   if (allow_slot_compaction && record_id.slot_number == header_.num_slots) {
     // Last slot in the list, so we need to free any unused slots that are at
@@ -127,7 +182,8 @@ bool Page::hasSpaceForRecord(const std::string& record_data) const {
   if (header_.num_free_slots == 0) {
     record_size += sizeof(PageSlot);
   }
-  return record_size <= getFreeSpace();
+  // dead space counts: compaction will reclaim it before the insert fails
+  return record_size <= getFreeSpace() + header_.dead_space;
 }
 
 PageSlot* Page::getSlot(const SlotId slot_number) {
@@ -141,16 +197,12 @@ const PageSlot& Page::getSlot(const SlotId slot_number) const {
 SlotId Page::getAvailableSlot() {
   SlotId slot_number = INVALID_SLOT;
   if (header_.num_free_slots > 0) {
-    // Have an allocated but unused slot that we can reuse.
-    for (SlotId i = 1; i <= header_.num_slots; ++i) {
-      const PageSlot* slot = getSlot(i);
-      if (!slot->used) {
-        // We don't decrement the number of free slots until someone actually
-        // puts data in the slot.
-        slot_number = i;
-        break;
-      }
-    }
+    // Have an allocated but unused slot that we can reuse.  Start at the
+    // first-free hint: no slot below it is free, so the common
+    // delete-then-insert pattern finds its slot immediately instead of
+    // rescanning the whole array.  We don't decrement the number of free
+    // slots until someone actually puts data in the slot.
+    slot_number = scanSlots(header_.first_free_slot_hint, false /* want_used */);
   } else {
     // Have to allocate a new slot.
     slot_number = header_.num_slots + 1;
@@ -159,11 +211,19 @@ SlotId Page::getAvailableSlot() {
     header_.free_space_lower_bound = sizeof(PageSlot) * header_.num_slots;
   }
   assert(slot_number != INVALID_SLOT);
+  header_.first_free_slot_hint = slot_number;
   return slot_number;
 }
 
 void Page::insertRecordInSlot(const SlotId slot_number,
                               const std::string& record_data) {
+  insertRecordInSlot(slot_number, record_data.data(),
+                     (std::uint16_t)record_data.length());
+}
+
+char* Page::insertRecordInSlot(const SlotId slot_number,
+                               const char* record_data,
+                               const std::uint16_t length) {
   if (slot_number > header_.num_slots ||
       slot_number == INVALID_SLOT) {
     throw InvalidSlotException(page_number(), slot_number);
@@ -172,13 +232,105 @@ void Page::insertRecordInSlot(const SlotId slot_number,
   if (slot->used) {
     throw SlotInUseException(page_number(), slot_number);
   }
-  const int record_length = record_data.length();
   slot->used = true;
-  slot->item_length = record_length;
-  slot->item_offset = header_.free_space_upper_bound - record_length;
+  slot->item_length = length;
+  slot->item_offset = header_.free_space_upper_bound - length;
   header_.free_space_upper_bound = slot->item_offset;
   --header_.num_free_slots;
-  data_.replace(slot->item_offset, slot->item_length, record_data);
+  if (slot_number == header_.first_free_slot_hint) {
+    // Slots below the hint are all used, and this one just joined them.
+    ++header_.first_free_slot_hint;
+  }
+  char* destination = &data_[slot->item_offset];
+  if (record_data != NULL) {
+    std::memcpy(destination, record_data, length);
+  }
+  return destination;
+}
+
+SlotId Page::scanSlots(const SlotId first, const bool want_used) const {
+  const SlotId count = header_.num_slots;
+  SlotId i = first;
+  if (i < 1) {
+    i = 1;
+  }
+
+  // Scalar until i sits on a 4-slot chunk boundary.
+  for (; i <= count && ((i - 1) & 3) != 0; ++i) {
+    if (getSlot(i).used == want_used) {
+      return i;
+    }
+  }
+
+  // Word-parallel middle: examine 4 slots per step and fall through only
+  // when the chunk contains a match.
+  for (; i + 3 <= count; i += 4) {
+    const std::size_t base = (std::size_t)(i - 1) * sizeof(PageSlot);
+    std::uint64_t w0, w1, w2;
+    std::memcpy(&w0, &data_[base], sizeof(w0));
+    std::memcpy(&w1, &data_[base + 8], sizeof(w1));
+    std::memcpy(&w2, &data_[base + 16], sizeof(w2));
+    const std::uint64_t used0 = w0 & kUsedMaskWord0;
+    const std::uint64_t used1 = w1 & kUsedMaskWord1;
+    const std::uint64_t used2 = w2 & kUsedMaskWord2;
+
+    if (want_used) {
+      if ((used0 | used1 | used2) == 0) {
+        continue; // all four slots free
+      }
+      if ((used0 & 0xFF) != 0) return i;
+      if ((used0 >> 48) != 0) return i + 1;
+      if (used1 != 0) return i + 2;
+      return i + 3;
+    }
+
+    if (used0 == kAllUsedWord0 && used1 == kAllUsedWord1 &&
+        used2 == kAllUsedWord2) {
+      continue; // all four slots used
+    }
+    if ((used0 & 0xFF) == 0) return i;
+    if ((used0 >> 48) == 0) return i + 1;
+    if (used1 == 0) return i + 2;
+    return i + 3;
+  }
+
+  // Scalar tail.
+  for (; i <= count; ++i) {
+    if (getSlot(i).used == want_used) {
+      return i;
+    }
+  }
+  return INVALID_SLOT;
+}
+
+void Page::compact() {
+  // Collect the live slots and process them from the highest data offset
+  // down, sliding each record up against the space reclaimed so far.
+  std::vector<SlotId> live;
+  live.reserve(header_.num_slots);
+  for (SlotId i = 1; i <= header_.num_slots; ++i) {
+    if (getSlot(i)->used) {
+      live.push_back(i);
+    }
+  }
+  std::sort(live.begin(), live.end(), [this](const SlotId a, const SlotId b) {
+    return getSlot(a)->item_offset > getSlot(b)->item_offset;
+  });
+
+  std::uint16_t new_upper_bound = DATA_SIZE;
+  for (std::size_t i = 0; i < live.size(); ++i) {
+    PageSlot* slot = getSlot(live[i]);
+    const std::uint16_t new_offset = new_upper_bound - slot->item_length;
+    if (new_offset != slot->item_offset) {
+      std::memmove(&data_[new_offset], &data_[slot->item_offset],
+                   slot->item_length);
+      slot->item_offset = new_offset;
+    }
+    new_upper_bound = new_offset;
+  }
+
+  header_.free_space_upper_bound = new_upper_bound;
+  header_.dead_space = 0;
 }
 
 void Page::validateRecordId(const RecordId& record_id) const {
@@ -10,10 +10,20 @@
 #include <cstddef>
 #include <stdint.h>
 #include <memory>
+#include <ostream>
 #include <string>
 
 #include "types.h"
 
+/**
+ * Compile-time page size override.  Deployments that favor a different page
+ * size (e.g. 4096 to match device sectors, or 65536 for sequential scans)
+ * build with -DBADGERDB_PAGE_SIZE=<bytes> instead of patching this header.
+ */
+#ifndef BADGERDB_PAGE_SIZE
+#define BADGERDB_PAGE_SIZE 8192
+#endif
+
 namespace badgerdb {
 
 /**
@@ -57,6 +67,30 @@ struct PageHeader {
    */
   PageId next_page_number;
 
+  /**
+   * Lowest slot number that may be free; no slot below it is ever free.
+   * Lets record insertion find a reusable slot without scanning the whole
+   * slot array on delete-heavy pages.
+   */
+  SlotId first_free_slot_hint;
+
+  /**
+   * Bytes occupied by deleted records that have not been compacted away
+   * yet.  Deletes only mark their slot free and grow this count; the data
+   * area is compacted lazily when an insert needs the space or the count
+   * passes Page::DEAD_SPACE_THRESHOLD.
+   */
+  std::uint16_t dead_space;
+
+  /**
+   * CRC32C of the page's data area, maintained by File: set on every page
+   * write and verified (per File's checksum mode) on every page read.
+   * Covers only the data bytes so header-only patches of the next-page
+   * pointer don't invalidate it.  Meaningless while the page is only in
+   * memory, so it takes no part in operator==.
+   */
+  std::uint32_t checksum;
+
   /**
    * Returns true if this page header is equal to the other.
    *
@@ -94,6 +128,44 @@ struct PageSlot {
 
 class PageIterator;
 
+/**
+ * @brief Non-owning view of a record's bytes in place on a page.
+ *
+ * A view is just a pointer/length pair into the page's data area — no
+ * allocation, no copy. It stays valid only while the page stays pinned in
+ * memory and the record is not updated, deleted or moved by a deletion of
+ * another record on the page; callers needing the bytes beyond that must
+ * copy them (e.g. with toString()).
+ */
+struct RecordView {
+  /**
+   * First byte of the record.
+   */
+  const char* data;
+
+  /**
+   * Length of the record in bytes.
+   */
+  std::uint16_t length;
+
+  /**
+   * Copies the viewed bytes into an owning string.
+   */
+  std::string toString() const { return std::string(data, length); }
+};
+
+/**
+ * Writes the viewed record bytes to the stream.
+ *
+ * @param out   Stream to write to.
+ * @param view  View to write.
+ * @return  The stream.
+ */
+inline std::ostream& operator<<(std::ostream& out, const RecordView& view) {
+  out.write(view.data, view.length);
+  return out;
+}
+
 /**
  * @brief Class which represents a fixed-size database page containing records.
  *
@@ -107,16 +179,24 @@ class PageIterator;
 class Page {
  public:
   /**
-   * Page size in bytes.  If this is changed, database files created with a
-   * different page size value will be unreadable by the resulting binaries.
+   * Page size in bytes.  Configurable per build via -DBADGERDB_PAGE_SIZE
+   * (see PAGE_SIZE in the Makefile); since it is a compile-time constant,
+   * all page offsets still constant-fold.  Database files created with a
+   * different page size value are unreadable by the resulting binaries.
    */
-  static const std::size_t SIZE = 8192;
+  static const std::size_t SIZE = BADGERDB_PAGE_SIZE;
 
   /**
    * Size of page free space area in bytes.
    */
   static const std::size_t DATA_SIZE = SIZE - sizeof(PageHeader);
 
+  /**
+   * Dead (deleted but uncompacted) bytes a page tolerates before a delete
+   * triggers compaction, amortizing the data shuffle across many deletes.
+   */
+  static const std::size_t DEAD_SPACE_THRESHOLD = DATA_SIZE / 8;
+
   /**
    * Number of page indicating that it's invalid.
    */
@@ -150,6 +230,47 @@ class Page {
    */
   std::string getRecord(const RecordId& record_id) const;
 
+  /**
+   * Returns a zero-copy view of the record with the given ID.  The view
+   * points into the page's own data area; see RecordView for its validity
+   * rules.
+   *
+   * @see RecordView
+   * @param record_id   ID of record to view.
+   * @return  View of the record.
+   * @throws  InvalidRecordException  If the record doesn't exist on the page.
+   */
+  RecordView getRecordView(const RecordId& record_id) const;
+
+  /**
+   * Inserts a new record from a raw buffer, without requiring the caller
+   * to materialize a std::string.  Otherwise identical to
+   * insertRecord(const std::string&).
+   *
+   * @param record_data   First byte of the record.
+   * @param length        Length of the record in bytes.
+   * @return  ID of the inserted record.
+   * @throws  InsufficientSpaceException  If the page doesn't have space for
+   *                                      the record.
+   */
+  RecordId insertRecord(const char* record_data, const std::uint16_t length);
+
+  /**
+   * Reserves space for a record of the given length and returns a pointer
+   * to its destination bytes, so callers can serialize in place instead of
+   * building the record in a temporary buffer first.  The record is live
+   * as soon as this returns; the caller must fill all <length> bytes
+   * before unpinning the page.
+   *
+   * @param length      Length of the record in bytes.
+   * @param record_id   Reference through which the new record's ID is
+   *                    returned.
+   * @return  First destination byte of the record.
+   * @throws  InsufficientSpaceException  If the page doesn't have space for
+   *                                      the record.
+   */
+  char* reserveRecord(const std::uint16_t length, RecordId& record_id);
+
   /**
    * Updates the record with the given ID, replacing its data with a new
    * version.  This is equivalent to deleting the old record and inserting a
@@ -300,6 +421,59 @@ class Page {
    *                                unallocated slot.
    * @throws  SlotInUseException  Thrown when given slot is in use.
    */
+  /**
+   * Body shared by insertRecord(const char*, uint16_t) and
+   * reserveRecord(): checks space, picks a slot and delegates to
+   * insertRecordInSlot.
+   *
+   * @param record_data   First byte of the record, or NULL to only reserve.
+   * @param length        Length of the record in bytes.
+   * @param record_id     Reference through which the new record's ID is
+   *                      returned.
+   * @return  First destination byte of the record.
+   * @throws  InsufficientSpaceException  If the page doesn't have space for
+   *                                      the record.
+   */
+  char* insertRecordInternal(const char* record_data,
+                             const std::uint16_t length, RecordId& record_id);
+
+  /**
+   * Finds the first slot numbered >= <first> whose used flag matches
+   * <want_used>, scanning the slot array four slots (one 24-byte chunk) at
+   * a time with word-wide loads instead of touching each PageSlot
+   * individually.  Backs both free-slot search on insert and used-slot
+   * search during page iteration.
+   *
+   * @param first       Lowest slot number to consider.
+   * @param want_used   Whether to look for a used or a free slot.
+   * @return  Matching slot number, or INVALID_SLOT if none exists.
+   */
+  SlotId scanSlots(const SlotId first, const bool want_used) const;
+
+  /**
+   * Compacts the data area: slides every live record up against the end of
+   * the page so the space held by deleted records becomes contiguous free
+   * space.  Slot numbers (and so record IDs) are unchanged; only
+   * item_offsets move.
+   */
+  void compact();
+
+  /**
+   * Performs the bookkeeping shared by the insertion paths: marks the slot
+   * used, carves <length> bytes off the free space and copies the record
+   * in (or leaves the destination for the caller when record_data is
+   * null, as reserveRecord does).
+   *
+   * @param slot_number   Slot to insert into.
+   * @param record_data   First byte of the record, or NULL to only reserve.
+   * @param length        Length of the record in bytes.
+   * @return  First destination byte of the record.
+   * @throws  InvalidSlotException  If the slot is not currently allocated.
+   * @throws  SlotInUseException    If the slot already contains data.
+   */
+  char* insertRecordInSlot(const SlotId slot_number, const char* record_data,
+                           const std::uint16_t length);
+
   void insertRecordInSlot(const SlotId slot_number,
                           const std::string& record_data);
 
@@ -327,10 +501,12 @@ class Page {
 
   /**
    * Data stored on the page.  Includes bookkeeping information about slots as
-   * well as actual content.
+   * well as actual content.  Stored inline as a fixed-size array so a Page is
+   * one contiguous block with no heap indirection; an array of Pages (the
+   * buffer pool) is a single contiguous slab and page copies are plain
+   * memcpys.
    */
-
-  std::string data_;
+  char data_[DATA_SIZE];
 
   friend class File;
   friend class PageIterator;
@@ -340,7 +516,11 @@ class Page {
 
 static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
+static_assert((Page::SIZE & (Page::SIZE - 1)) == 0,
+              "Page size must be a power of two.");
 static_assert(Page::DATA_SIZE > 0,
               "Page must have some space to hold data.");
+static_assert(sizeof(Page) == Page::SIZE,
+              "Page must be exactly one page-sized contiguous block.");
 
 }
@@ -92,13 +92,14 @@ class PageIterator {
   }
 
   /**
-   * Dereferences the iterator, returning a copy of the current record in the
-   * page.
+   * Dereferences the iterator, returning a zero-copy view of the current
+   * record in the page.  The view follows RecordView's validity rules;
+   * scans that keep record bytes around must copy them out.
    *
-   * @return  Record in page.
+   * @return  View of the record in the page.
    */
-	inline std::string operator*() const {
-		return page_->getRecord(current_record_); 
+	inline RecordView operator*() const {
+		return page_->getRecordView(current_record_); 
 	}
 
   /**
@@ -109,15 +110,7 @@ class PageIterator {
    * @return  Next used slot after given slot or Page::INVALID_SLOT.
    */
   SlotId getNextUsedSlot(const SlotId start) const {
-    SlotId slot_number = Page::INVALID_SLOT;
-    for (SlotId i = start + 1; i <= page_->header_.num_slots; ++i) {
-      const PageSlot* slot = page_->getSlot(i);
-      if (slot->used) {
-        slot_number = i;
-        break;
-      }
-    }
-    return slot_number;
+    return page_->scanSlots(start + 1, true /* want_used */);
   }
 
  private:
@@ -24,6 +24,11 @@ typedef std::uint16_t SlotId;
  */
 typedef std::uint32_t FrameId;
 
+/**
+ * @brief Dense identifier interned for each distinct filename at open time.
+ */
+typedef std::uint32_t FileId;
+
 /**
  * @brief Identifier for a record in a page.
  */
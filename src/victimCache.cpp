@@ -0,0 +1,247 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "victimCache.h"
+
+#include <cstring>
+
+namespace badgerdb {
+
+namespace {
+
+// A small LZ77-class byte codec, shaped like LZ4's token stream but
+// simplified for fixed page-sized inputs. The stream is a sequence of
+// tokens: a byte with the high bit clear introduces a literal run of
+// (byte + 1) bytes, 1..128, copied verbatim; a byte with the high bit set
+// introduces a match of ((byte & 0x7F) + 4) bytes, 4..131, copied from
+// (distance) bytes back in the output, where distance follows as two
+// little-endian bytes. Matches are found with a 4-byte hash table; the
+// window (64KB) always covers a whole page.
+
+const std::size_t kMinMatch = 4;
+const std::size_t kMaxMatch = 131;
+const std::size_t kMaxLiterals = 128;
+const std::size_t kMaxDistance = 65535;
+const std::uint32_t kHashBits = 12;
+
+inline std::uint32_t hashSequence(const std::uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+// Appends a literal run in kMaxLiterals-sized chunks; returns false if the
+// output would exceed <cap>.
+bool emitLiterals(const unsigned char* src, std::size_t count,
+                  unsigned char* dst, std::size_t& out,
+                  const std::size_t cap) {
+  while (count > 0) {
+    const std::size_t chunk = count < kMaxLiterals ? count : kMaxLiterals;
+    if (out + 1 + chunk > cap) {
+      return false;
+    }
+    dst[out++] = (unsigned char)(chunk - 1);
+    std::memcpy(dst + out, src, chunk);
+    out += chunk;
+    src += chunk;
+    count -= chunk;
+  }
+  return true;
+}
+
+// Compresses <n> bytes of <src> into <dst>; returns the compressed size,
+// or 0 if the result would not fit in <cap> bytes.
+std::size_t compressBytes(const unsigned char* src, const std::size_t n,
+                          unsigned char* dst, const std::size_t cap) {
+  std::uint32_t table[1u << kHashBits];
+  std::memset(table, 0, sizeof(table)); // position + 1; 0 is empty
+
+  std::size_t pos = 0;
+  std::size_t literalStart = 0;
+  std::size_t out = 0;
+
+  while (pos + kMinMatch <= n) {
+    std::uint32_t sequence;
+    std::memcpy(&sequence, src + pos, sizeof(sequence));
+    const std::uint32_t hash = hashSequence(sequence);
+    const std::uint32_t candidate = table[hash];
+    table[hash] = (std::uint32_t)(pos + 1);
+
+    if (candidate != 0) {
+      const std::size_t matchPos = candidate - 1;
+      std::uint32_t candidateSequence;
+      std::memcpy(&candidateSequence, src + matchPos,
+                  sizeof(candidateSequence));
+      if (candidateSequence == sequence &&
+          pos - matchPos <= kMaxDistance) {
+        std::size_t length = kMinMatch;
+        while (pos + length < n && length < kMaxMatch &&
+               src[matchPos + length] == src[pos + length]) {
+          length++;
+        }
+        if (!emitLiterals(src + literalStart, pos - literalStart, dst, out,
+                          cap)) {
+          return 0;
+        }
+        if (out + 3 > cap) {
+          return 0;
+        }
+        const std::size_t distance = pos - matchPos;
+        dst[out++] = (unsigned char)(0x80 | (length - kMinMatch));
+        dst[out++] = (unsigned char)(distance & 0xFF);
+        dst[out++] = (unsigned char)(distance >> 8);
+        pos += length;
+        literalStart = pos;
+        continue;
+      }
+    }
+    pos++;
+  }
+
+  if (!emitLiterals(src + literalStart, n - literalStart, dst, out, cap)) {
+    return 0;
+  }
+  return out;
+}
+
+// Decompresses <n> bytes of <src> into exactly <cap> bytes of <dst>;
+// returns false on any malformed token or size mismatch.
+bool decompressBytes(const unsigned char* src, const std::size_t n,
+                     unsigned char* dst, const std::size_t cap) {
+  std::size_t in = 0;
+  std::size_t out = 0;
+  while (in < n) {
+    const unsigned char token = src[in++];
+    if (token & 0x80) {
+      const std::size_t length = (std::size_t)(token & 0x7F) + kMinMatch;
+      if (in + 2 > n) {
+        return false;
+      }
+      const std::size_t distance =
+          (std::size_t)src[in] | ((std::size_t)src[in + 1] << 8);
+      in += 2;
+      if (distance == 0 || distance > out || out + length > cap) {
+        return false;
+      }
+      // byte-wise so overlapping matches (run-length style) replicate
+      for (std::size_t i = 0; i < length; i++) {
+        dst[out + i] = dst[out - distance + i];
+      }
+      out += length;
+    } else {
+      const std::size_t count = (std::size_t)token + 1;
+      if (in + count > n || out + count > cap) {
+        return false;
+      }
+      std::memcpy(dst + out, src + in, count);
+      in += count;
+      out += count;
+    }
+  }
+  return out == cap;
+}
+
+}
+
+VictimCache::VictimCache()
+    : maxBytes(0), usedBytes(0), hits(0), stores(0), evictions(0) {
+}
+
+void VictimCache::setCapacity(const std::size_t maxBytesIn) {
+  std::lock_guard<std::mutex> lock(latch);
+  maxBytes = maxBytesIn;
+  evictToFit(0);
+}
+
+void VictimCache::evictToFit(const std::size_t incoming) {
+  while (usedBytes + incoming > maxBytes && !lru.empty()) {
+    const std::uint64_t key = lru.back();
+    std::unordered_map<std::uint64_t, Entry>::iterator it = entries.find(key);
+    usedBytes -= it->second.bytes.size();
+    entries.erase(it);
+    lru.pop_back();
+    evictions++;
+  }
+}
+
+void VictimCache::put(const FileId file, const PageId pageNo,
+                      const Page& page) {
+  static thread_local std::vector<unsigned char> scratch;
+  scratch.resize(Page::SIZE);
+
+  // Store only pages that actually shrink; an incompressible page is
+  // cheaper to re-read than to hold raw in the second tier.
+  const std::size_t compressed =
+      compressBytes(reinterpret_cast<const unsigned char*>(&page), Page::SIZE,
+                    &scratch[0], Page::SIZE - 1);
+  if (compressed == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(latch);
+  if (maxBytes == 0) {
+    return;
+  }
+  const std::uint64_t key = makeKey(file, pageNo);
+  std::unordered_map<std::uint64_t, Entry>::iterator it = entries.find(key);
+  if (it != entries.end()) {
+    usedBytes -= it->second.bytes.size();
+    lru.erase(it->second.lruPos);
+    entries.erase(it);
+  }
+  evictToFit(compressed);
+  if (usedBytes + compressed > maxBytes) {
+    return; // cap smaller than one page
+  }
+  Entry& entry = entries[key];
+  entry.bytes.assign(scratch.begin(), scratch.begin() + compressed);
+  lru.push_front(key);
+  entry.lruPos = lru.begin();
+  usedBytes += compressed;
+  stores++;
+}
+
+bool VictimCache::get(const FileId file, const PageId pageNo, Page& page) {
+  std::vector<unsigned char> bytes;
+  {
+    std::lock_guard<std::mutex> lock(latch);
+    std::unordered_map<std::uint64_t, Entry>::iterator it =
+        entries.find(makeKey(file, pageNo));
+    if (it == entries.end()) {
+      return false;
+    }
+    // The page is about to be resident again; drop the entry and
+    // decompress outside the latch.
+    bytes.swap(it->second.bytes);
+    usedBytes -= bytes.size();
+    lru.erase(it->second.lruPos);
+    entries.erase(it);
+    hits++;
+  }
+  return decompressBytes(&bytes[0], bytes.size(),
+                         reinterpret_cast<unsigned char*>(&page), Page::SIZE);
+}
+
+void VictimCache::remove(const FileId file, const PageId pageNo) {
+  std::lock_guard<std::mutex> lock(latch);
+  std::unordered_map<std::uint64_t, Entry>::iterator it =
+      entries.find(makeKey(file, pageNo));
+  if (it == entries.end()) {
+    return;
+  }
+  usedBytes -= it->second.bytes.size();
+  lru.erase(it->second.lruPos);
+  entries.erase(it);
+}
+
+void VictimCache::getStats(std::uint64_t& hitsOut, std::uint64_t& storesOut,
+                           std::uint64_t& evictionsOut) {
+  std::lock_guard<std::mutex> lock(latch);
+  hitsOut = hits;
+  storesOut = stores;
+  evictionsOut = evictions;
+}
+
+}
@@ -0,0 +1,165 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Compressed second-tier cache for pages evicted from the buffer
+ * pool.
+ *
+ * When the pool evicts a page the bytes are gone and the next reference
+ * pays a full disk read. A VictimCache keeps evicted pages around in
+ * compressed form (an LZ-class byte codec, implemented in the translation
+ * unit) inside a byte-capped store, so a re-reference decompresses in
+ * microseconds instead of re-faulting from disk in milliseconds. Entries
+ * are removed on hit (the page is resident again) and recycled in LRU
+ * order when the cap is exceeded; pages that do not shrink below the page
+ * size are not stored. Dirty pages are written back before they reach the
+ * cache, so an entry always matches the bytes on disk.
+ *
+ * Keys are interned file ids, which outlive File objects; a caller that
+ * deletes a page must remove() it here too (BufMgr::disposePage does).
+ */
+class VictimCache {
+ public:
+  /**
+   * Constructs a disabled cache (zero capacity).
+   */
+  VictimCache();
+
+  /**
+   * Sets the capacity in compressed bytes, evicting LRU entries if the
+   * store already exceeds it. Zero disables the cache and drops all
+   * entries.
+   *
+   * @param maxBytesIn  Capacity in bytes of compressed page data.
+   */
+  void setCapacity(const std::size_t maxBytesIn);
+
+  /**
+   * Returns true if the cache has nonzero capacity.
+   */
+  bool enabled() const { return maxBytes != 0; }
+
+  /**
+   * Compresses and stores a page, evicting LRU entries to make room.
+   * Does nothing if the cache is disabled or the page is incompressible.
+   *
+   * @param file    Interned id of the file the page belongs to.
+   * @param pageNo  Number of the page within the file.
+   * @param page    The page to store.
+   */
+  void put(const FileId file, const PageId pageNo, const Page& page);
+
+  /**
+   * Looks a page up and, on a hit, decompresses it into <page> and drops
+   * the entry.
+   *
+   * @param file    Interned id of the file the page belongs to.
+   * @param pageNo  Number of the page within the file.
+   * @param page    Receives the decompressed page on a hit.
+   * @return  True if the page was found and decompressed.
+   */
+  bool get(const FileId file, const PageId pageNo, Page& page);
+
+  /**
+   * Drops the entry for a page, if present (e.g. the page was deleted).
+   *
+   * @param file    Interned id of the file the page belongs to.
+   * @param pageNo  Number of the page within the file.
+   */
+  void remove(const FileId file, const PageId pageNo);
+
+  /**
+   * Returns the cache's counters: successful lookups, pages stored, and
+   * entries recycled to stay under the byte cap.
+   *
+   * @param hitsOut       Receives the hit count.
+   * @param storesOut     Receives the store count.
+   * @param evictionsOut  Receives the recycle count.
+   */
+  void getStats(std::uint64_t& hitsOut, std::uint64_t& storesOut,
+                std::uint64_t& evictionsOut);
+
+ private:
+  /**
+   * One cached page: its compressed bytes and its position in the LRU
+   * list.
+   */
+  struct Entry {
+    std::vector<unsigned char> bytes;
+    std::list<std::uint64_t>::iterator lruPos;
+  };
+
+  /**
+   * Combines a file id and page number into one lookup key.
+   */
+  static std::uint64_t makeKey(const FileId file, const PageId pageNo) {
+    return ((std::uint64_t)file << 32) | pageNo;
+  }
+
+  /**
+   * Recycles LRU entries until <incoming> more bytes fit under the cap.
+   * Caller holds the latch.
+   *
+   * @param incoming  Bytes about to be inserted.
+   */
+  void evictToFit(const std::size_t incoming);
+
+  /**
+   * Cached pages, keyed by (file id, page number).
+   */
+  std::unordered_map<std::uint64_t, Entry> entries;
+
+  /**
+   * Keys in recency order; front is most recently touched.
+   */
+  std::list<std::uint64_t> lru;
+
+  /**
+   * Capacity in compressed bytes; zero means disabled.
+   */
+  std::size_t maxBytes;
+
+  /**
+   * Compressed bytes currently stored.
+   */
+  std::size_t usedBytes;
+
+  /**
+   * Successful lookups.
+   */
+  std::uint64_t hits;
+
+  /**
+   * Pages stored.
+   */
+  std::uint64_t stores;
+
+  /**
+   * Entries recycled to stay under the byte cap.
+   */
+  std::uint64_t evictions;
+
+  /**
+   * Guards everything above.
+   */
+  std::mutex latch;
+};
+
+}